@@ -1,15 +1,21 @@
 #include "devices/disk.h"
 #include <ctype.h>
 #include <debug.h>
+#include <list.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].  Data moves by
+   PIO, or by bus-master DMA on a PIIX-style controller when
+   disk_dma_enabled is set before disk_init(). */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -32,6 +38,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +54,50 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Bus-master IDE registers, relative to a channel's bm_base. */
+#define bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)   /* Command. */
+#define bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)    /* Status. */
+#define bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)      /* PRD table address. */
+
+/* Bus-master command and status bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+#define BM_STA_ERR 0x02         /* Transfer failed (write 1 to clear). */
+#define BM_STA_IRQ 0x04         /* Disk interrupted (write 1 to clear). */
+#define BM_STA_DRV0 0x20        /* Device 0 is DMA capable. */
+#define BM_STA_DRV1 0x40        /* Device 1 is DMA capable. */
+
+/* PCI configuration space access mechanism #1. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* Requests that have waited this many timer ticks are dispatched
+   ahead of the elevator order. */
+#define READ_DEADLINE (TIMER_FREQ / 2)
+#define WRITE_DEADLINE (TIMER_FREQ * 2)
+
+/* A Physical Region Descriptor: one physically contiguous piece of a
+   DMA buffer that does not cross a 64 kB boundary. */
+struct prd {
+	uint32_t addr;              /* Physical address. */
+	uint16_t size;              /* Byte count, 0 means 64 kB. */
+	uint16_t flags;             /* PRD_EOT on the last entry. */
+};
+#define PRD_EOT 0x8000
+
+/* True to use bus-master DMA when a controller is found. */
+bool disk_dma_enabled;
+
+/* Most sectors a single command can transfer (a sector count of 0
+   means 256). */
+#define MAX_XFER_SECTORS 256
 
 /* An ATA device. */
 struct disk {
@@ -56,11 +107,27 @@ struct disk {
 
 	bool is_ata;                /* 1=This device is an ATA disk. */
 	disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+	int multiple;               /* Sectors per interrupt for READ/WRITE
+								   MULTIPLE, or 0 if not enabled. */
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
 };
 
+/* A request to move CNT sectors starting at SEC_NO between DISK
+   and BUFFER.  Lives on the requesting thread's stack while it
+   waits in its channel's queue. */
+struct disk_request {
+	struct disk *disk;          /* Disk to access. */
+	disk_sector_t sec_no;       /* First sector. */
+	size_t cnt;                 /* Number of sectors. */
+	uint8_t *buffer;            /* CNT * DISK_SECTOR_SIZE bytes. */
+	bool write;                 /* Direction. */
+	int64_t deadline;           /* Dispatch by this tick. */
+	struct list_elem elem;      /* Channel queue or batch element. */
+	struct semaphore done;      /* Up'd when the transfer completes. */
+};
+
 /* An ATA channel (aka controller).
    Each channel can control up to two disks. */
 struct channel {
@@ -68,11 +135,31 @@ struct channel {
 	uint16_t reg_base;          /* Base I/O port. */
 	uint8_t irq;                /* Interrupt in use. */
 
-	struct lock lock;           /* Must acquire to access the controller. */
+	struct lock lock;           /* Protects the request queue. */
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	uint16_t bm_base;           /* Bus-master I/O port, 0 if PIO only. */
+	struct prd *prdt;           /* PRD table, one page. */
+
+	/* Request queue, in arrival order.  Only the channel's
+	   dispatcher thread touches the controller once disk_init()
+	   is done. */
+	struct list queue;
+	struct condition queue_nonempty;
+	uint64_t head;              /* Elevator position, see request_pos(). */
+
+	/* Scheduler statistics. */
+	long long request_cnt;      /* Requests submitted. */
+	long long command_cnt;      /* Commands issued for them. */
+	long long merge_cnt;        /* Requests merged into another's command. */
+	long long expired_cnt;      /* Dispatched for missing their deadline. */
+	long long depth_sum;        /* Sum of queue depths at dispatch. */
+	size_t depth_max;           /* Deepest queue seen at dispatch. */
+	int64_t latency_sum;        /* Total request latency, in ns. */
+	int64_t latency_max;        /* Longest request latency, in ns. */
+
 	struct disk devices[2];     /* The devices on this channel. */
 };
 
@@ -83,8 +170,24 @@ static struct channel channels[CHANNEL_CNT];
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
-
-static void select_sector (struct disk *, disk_sector_t);
+static void set_multiple_mode (struct disk *, int sectors);
+
+static void submit_request (struct disk *, disk_sector_t, size_t cnt,
+		void *, bool write);
+static void channel_dispatcher (void *channel_);
+static void pick_batch (struct channel *, struct list *batch);
+static void transfer_batch (struct list *batch);
+
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
+static void pio_read (struct disk *, disk_sector_t, size_t cnt,
+		struct list *batch);
+static void pio_write (struct disk *, disk_sector_t, size_t cnt,
+		struct list *batch);
+
+static uint16_t find_bus_master (void);
+static void setup_dma (struct channel *, uint16_t bm_base);
+static bool dma_transfer (struct disk *, disk_sector_t, size_t cnt,
+		struct list *batch, bool write);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -99,6 +202,7 @@ static void interrupt_handler (struct intr_frame *);
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) {
+	uint16_t bm_base = disk_dma_enabled ? find_bus_master () : 0;
 	size_t chan_no;
 
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
@@ -122,6 +226,15 @@ disk_init (void) {
 		lock_init (&c->lock);
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
+		c->bm_base = 0;
+		c->prdt = NULL;
+		list_init (&c->queue);
+		cond_init (&c->queue_nonempty);
+		c->head = 0;
+		c->request_cnt = c->command_cnt = c->merge_cnt = 0;
+		c->expired_cnt = c->depth_sum = 0;
+		c->depth_max = 0;
+		c->latency_sum = c->latency_max = 0;
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -132,6 +245,7 @@ disk_init (void) {
 
 			d->is_ata = false;
 			d->capacity = 0;
+			d->multiple = 0;
 
 			d->read_cnt = d->write_cnt = 0;
 		}
@@ -150,6 +264,20 @@ disk_init (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device (&c->devices[dev_no]);
+
+		/* The primary channel's bus-master registers come first, the
+		   secondary's 8 ports later. */
+		if (bm_base != 0)
+			setup_dma (c, bm_base + chan_no * 8);
+
+		/* From here on the channel is driven by its dispatcher. */
+		if (c->devices[0].is_ata || c->devices[1].is_ata) {
+			char name[16];
+			snprintf (name, sizeof name, "%s-io", c->name);
+			if (thread_create (name, PRI_MAX, channel_dispatcher, c)
+					== TID_ERROR)
+				PANIC ("%s: cannot start I/O dispatcher", c->name);
+		}
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
@@ -162,6 +290,7 @@ disk_print_stats (void) {
 	int chan_no;
 
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
+		struct channel *c = &channels[chan_no];
 		int dev_no;
 
 		for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -170,6 +299,17 @@ disk_print_stats (void) {
 				printf ("%s: %lld reads, %lld writes\n",
 						d->name, d->read_cnt, d->write_cnt);
 		}
+
+		if (c->command_cnt > 0) {
+			long long avg = c->depth_sum * 100 / c->command_cnt;
+			printf ("%s: %lld requests in %lld commands (%lld merged, "
+					"%lld past deadline), queue depth max %zu avg %lld.%02lld\n",
+					c->name, c->request_cnt, c->command_cnt, c->merge_cnt,
+					c->expired_cnt, c->depth_max, avg / 100, avg % 100);
+			printf ("%s: request latency avg %lld us, max %lld us\n",
+					c->name, (long long) (c->latency_sum / c->request_cnt / 1000),
+					(long long) (c->latency_max / 1000));
+		}
 	}
 }
 
@@ -221,21 +361,10 @@ BUFFER는 DISK_SECTOR_SIZE 바이트의 공간이 있어야 합니다.
 외부의 디스크 당 잠금은 필요하지 않습니다. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	submit_request (d, sec_no, 1, buffer, false);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -250,22 +379,263 @@ BUFFER는 DISK_SECTOR_SIZE 바이트를 포함해야 합니다.
 외부의 디스크 당 잠금은 필요하지 않습니다. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
-	struct channel *c;
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+
+	submit_request (d, sec_no, 1, (void *) buffer, true);
+}
+
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  Each run of up to MAX_XFER_SECTORS sectors is moved by a
+   single command: by DMA with one interrupt, or by PIO with one
+   interrupt per block of D->multiple sectors when the disk supports
+   READ MULTIPLE.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multi (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer_) {
+	uint8_t *buffer = buffer_;
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
-	c = d->channel;
+	while (cnt > 0) {
+		size_t n = cnt < MAX_XFER_SECTORS ? cnt : MAX_XFER_SECTORS;
+		submit_request (d, sec_no, n, buffer, false);
+		sec_no += n;
+		buffer += n * DISK_SECTOR_SIZE;
+		cnt -= n;
+	}
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data.
+   Batched like disk_read_multi().
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multi (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const void *buffer_) {
+	uint8_t *buffer = (uint8_t *) buffer_;
+
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+
+	while (cnt > 0) {
+		size_t n = cnt < MAX_XFER_SECTORS ? cnt : MAX_XFER_SECTORS;
+		submit_request (d, sec_no, n, buffer, true);
+		sec_no += n;
+		buffer += n * DISK_SECTOR_SIZE;
+		cnt -= n;
+	}
+}
+
+/* Request scheduling. */
+
+/* Queues a request to move CNT sectors starting at SEC_NO between
+   disk D and BUFFER on D's channel and waits for the channel's
+   dispatcher to complete it. */
+static void
+submit_request (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer, bool write) {
+	struct channel *c = d->channel;
+	struct disk_request r;
+	int64_t start, latency;
+
+	ASSERT (cnt > 0 && cnt <= MAX_XFER_SECTORS);
+	ASSERT (sec_no < d->capacity && cnt <= d->capacity - sec_no);
+
+	r.disk = d;
+	r.sec_no = sec_no;
+	r.cnt = cnt;
+	r.buffer = buffer;
+	r.write = write;
+	r.deadline = timer_ticks () + (write ? WRITE_DEADLINE : READ_DEADLINE);
+	sema_init (&r.done, 0);
+	start = timer_ns ();
+
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	list_push_back (&c->queue, &r.elem);
+	c->request_cnt++;
+	cond_signal (&c->queue_nonempty, &c->lock);
+	lock_release (&c->lock);
+
+	sema_down (&r.done);
+
+	latency = timer_ns () - start;
+	lock_acquire (&c->lock);
+	c->latency_sum += latency;
+	if (latency > c->latency_max)
+		c->latency_max = latency;
 	lock_release (&c->lock);
 }
+
+/* Position of the sector just past request R on its channel, for
+   the elevator: device 0 sorts before device 1. */
+static uint64_t
+request_pos (const struct disk_request *r, disk_sector_t sec_no) {
+	return ((uint64_t) r->disk->dev_no << 32) | sec_no;
+}
+
+/* Dispatcher thread for channel C: repeatedly takes the next batch
+   of requests off the queue, moves its data with one command and
+   wakes the requesters. */
+static void
+channel_dispatcher (void *c_) {
+	struct channel *c = c_;
+
+	for (;;) {
+		struct list batch;
+
+		lock_acquire (&c->lock);
+		while (list_empty (&c->queue))
+			cond_wait (&c->queue_nonempty, &c->lock);
+		list_init (&batch);
+		pick_batch (c, &batch);
+		lock_release (&c->lock);
+
+		transfer_batch (&batch);
+
+		/* Wake the requesters.  Each request lives on its requester's
+		   stack, so it must be unlinked before it is signaled. */
+		while (!list_empty (&batch)) {
+			struct disk_request *r = list_entry (list_pop_front (&batch),
+					struct disk_request, elem);
+			sema_up (&r->done);
+		}
+	}
+}
+
+/* Moves the next batch of requests from channel C's queue into
+   BATCH, in ascending sector order.
+
+   The oldest request past its deadline goes first, which bounds
+   starvation.  Otherwise the elevator (C-LOOK) picks the lowest
+   position at or after the head, wrapping around to the lowest
+   position once nothing lies ahead.  Queued requests for the same
+   disk and direction that directly precede or follow the batch are
+   then merged into it, up to MAX_XFER_SECTORS sectors.
+   Must be called with C's lock held. */
+static void
+pick_batch (struct channel *c, struct list *batch) {
+	struct disk_request *first = NULL;
+	struct disk_request *ahead = NULL;
+	struct disk_request *lowest = NULL;
+	int64_t now = timer_ticks ();
+	size_t depth = list_size (&c->queue);
+	disk_sector_t start, end;
+	size_t cnt;
+	struct list_elem *e;
+	bool merged;
+
+	c->command_cnt++;
+	c->depth_sum += depth;
+	if (depth > c->depth_max)
+		c->depth_max = depth;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		uint64_t pos = request_pos (r, r->sec_no);
+
+		if (r->deadline <= now
+				&& (first == NULL || r->deadline < first->deadline))
+			first = r;
+		if (pos >= c->head
+				&& (ahead == NULL || pos < request_pos (ahead, ahead->sec_no)))
+			ahead = r;
+		if (lowest == NULL || pos < request_pos (lowest, lowest->sec_no))
+			lowest = r;
+	}
+	if (first != NULL)
+		c->expired_cnt++;
+	else
+		first = ahead != NULL ? ahead : lowest;
+
+	list_remove (&first->elem);
+	list_push_back (batch, &first->elem);
+	start = first->sec_no;
+	end = first->sec_no + first->cnt;
+	cnt = first->cnt;
+
+	do {
+		merged = false;
+		for (e = list_begin (&c->queue); e != list_end (&c->queue);
+				e = list_next (e)) {
+			struct disk_request *r = list_entry (e, struct disk_request, elem);
+
+			if (r->disk != first->disk || r->write != first->write
+					|| cnt + r->cnt > MAX_XFER_SECTORS)
+				continue;
+			if (r->sec_no == end) {
+				list_remove (&r->elem);
+				list_push_back (batch, &r->elem);
+				end += r->cnt;
+			} else if (r->sec_no + r->cnt == start) {
+				list_remove (&r->elem);
+				list_push_front (batch, &r->elem);
+				start = r->sec_no;
+			} else
+				continue;
+			cnt += r->cnt;
+			c->merge_cnt++;
+			merged = true;
+			break;
+		}
+	} while (merged);
+
+	c->head = request_pos (first, end);
+}
+
+/* Moves the data for BATCH, a list of requests for consecutive
+   sectors of one disk in one direction, with a single command: by
+   DMA if possible and otherwise by PIO. */
+static void
+transfer_batch (struct list *batch) {
+	struct disk_request *first = list_entry (list_front (batch),
+			struct disk_request, elem);
+	struct disk *d = first->disk;
+	size_t cnt = 0;
+	struct list_elem *e;
+
+	for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+		cnt += list_entry (e, struct disk_request, elem)->cnt;
+
+	if (dma_transfer (d, first->sec_no, cnt, batch, first->write))
+		return;
+	if (first->write)
+		pio_write (d, first->sec_no, cnt, batch);
+	else
+		pio_read (d, first->sec_no, cnt, batch);
+}
+
+/* Iterates over the per-sector buffers of a batch of requests. */
+struct batch_cursor {
+	struct list_elem *e;        /* Current request. */
+	size_t ofs;                 /* Sector index within it. */
+};
+
+static void
+cursor_init (struct batch_cursor *cur, struct list *batch) {
+	cur->e = list_begin (batch);
+	cur->ofs = 0;
+}
+
+/* Returns the buffer for the next sector and advances CUR. */
+static uint8_t *
+cursor_next (struct batch_cursor *cur) {
+	struct disk_request *r = list_entry (cur->e, struct disk_request, elem);
+	uint8_t *buffer = r->buffer + cur->ofs * DISK_SECTOR_SIZE;
+
+	if (++cur->ofs == r->cnt) {
+		cur->e = list_next (cur->e);
+		cur->ofs = 0;
+	}
+	return buffer;
+}
 
 /* Disk detection and identification. */
 
@@ -385,6 +755,11 @@ identify_ata_device (struct disk *d) {
 	/* Calculate capacity. */
 	d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+	/* Word 47 holds the largest block READ/WRITE MULTIPLE can move
+	   per interrupt. */
+	if ((id[47] & 0xff) > 1)
+		set_multiple_mode (d, id[47] & 0xff);
+
 	/* Print identification message. */
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -403,6 +778,27 @@ identify_ata_device (struct disk *d) {
 	printf ("\"\n");
 }
 
+/* Enables READ/WRITE MULTIPLE on disk D with a block size of at
+   most SECTORS sectors.  Leaves D->multiple at 0, so that plain
+   READ/WRITE SECTOR commands are used, if the disk refuses. */
+static void
+set_multiple_mode (struct disk *d, int sectors) {
+	struct channel *c = d->channel;
+	int block = 1;
+
+	/* Devices only accept powers of two. */
+	while (block * 2 <= sectors)
+		block *= 2;
+
+	select_device_wait (d);
+	outb (reg_nsect (c), block);
+	issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+	sema_down (&c->completion_wait);
+	wait_while_busy (d);
+	if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+		d->multiple = block;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -423,20 +819,21 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 /* 장치 D를 선택하고, 
 준비 상태가 될 때까지 대기한 다음 디스크의 섹터 
 선택 레지스터에 SEC_NO를 기록합니다. (LBA 모드를 사용합니다.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= MAX_XFER_SECTORS);
+	ASSERT (sec_no < d->capacity && cnt <= d->capacity - sec_no);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt == MAX_XFER_SECTORS ? 0 : cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -457,6 +854,63 @@ issue_pio_command (struct channel *c, uint8_t command) {
 	outb (reg_command (c), command);
 }
 
+/* Reads CNT sectors starting at SEC_NO from disk D into the buffers
+   of BATCH with a single PIO command. */
+static void
+pio_read (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		struct list *batch) {
+	struct channel *c = d->channel;
+	size_t block = d->multiple > 0 ? d->multiple : 1;
+	struct batch_cursor cur;
+	size_t done, i;
+
+	cursor_init (&cur, batch);
+	select_sector (d, sec_no, cnt);
+	issue_pio_command (c, d->multiple > 0 && cnt > 1
+			? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+	for (done = 0; done < cnt; done += block) {
+		size_t n = cnt - done < block ? cnt - done : block;
+
+		/* The disk interrupts once for each block it has ready. */
+		sema_down (&c->completion_wait);
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk read failed, sector=%"PRDSNu,
+					d->name, (disk_sector_t) (sec_no + done));
+		for (i = 0; i < n; i++)
+			input_sector (c, cursor_next (&cur));
+	}
+	d->read_cnt += cnt;
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from the buffers
+   of BATCH with a single PIO command. */
+static void
+pio_write (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		struct list *batch) {
+	struct channel *c = d->channel;
+	size_t block = d->multiple > 0 ? d->multiple : 1;
+	struct batch_cursor cur;
+	size_t done, i;
+
+	cursor_init (&cur, batch);
+	select_sector (d, sec_no, cnt);
+	issue_pio_command (c, d->multiple > 0 && cnt > 1
+			? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+	for (done = 0; done < cnt; done += block) {
+		size_t n = cnt - done < block ? cnt - done : block;
+
+		/* The disk interrupts after each block, and after the last
+		   one once the data has been accepted. */
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk write failed, sector=%"PRDSNu,
+					d->name, (disk_sector_t) (sec_no + done));
+		for (i = 0; i < n; i++)
+			output_sector (c, cursor_next (&cur));
+		sema_down (&c->completion_wait);
+	}
+	d->write_cnt += cnt;
+}
+
 /* Reads a sector from channel C's data register in PIO mode into
    SECTOR, which must have room for DISK_SECTOR_SIZE bytes. */
 static void
@@ -471,6 +925,163 @@ output_sector (struct channel *c, const void *sector) {
 	outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
 }
 
+/* Bus-master DMA. */
+
+/* Reads register REG of PCI function BUS:DEV.FUNC. */
+static uint32_t
+pci_read_config (int bus, int dev, int func, int reg) {
+	outl (PCI_CONFIG_ADDR, 0x80000000 | (bus << 16) | (dev << 11)
+			| (func << 8) | (reg & 0xfc));
+	return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to register REG of PCI function BUS:DEV.FUNC. */
+static void
+pci_write_config (int bus, int dev, int func, int reg, uint32_t value) {
+	outl (PCI_CONFIG_ADDR, 0x80000000 | (bus << 16) | (dev << 11)
+			| (func << 8) | (reg & 0xfc));
+	outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks on PCI bus 0 for a bus-master capable IDE controller, such
+   as the PIIX3/PIIX4 that QEMU and Bochs emulate, enables bus
+   mastering on it and returns the I/O port from its BAR4.  Returns
+   0 if there is none, in which case all transfers use PIO. */
+static uint16_t
+find_bus_master (void) {
+	int dev, func;
+
+	for (dev = 0; dev < 32; dev++)
+		for (func = 0; func < 8; func++) {
+			uint32_t id = pci_read_config (0, dev, func, 0x00);
+			uint32_t class, bar4, cmd;
+
+			if ((id & 0xffff) == 0xffff)
+				continue;
+
+			/* Class 01h (mass storage), subclass 01h (IDE), with the
+			   bus-master bit set in the programming interface. */
+			class = pci_read_config (0, dev, func, 0x08);
+			if ((class >> 16) != 0x0101 || (class & 0x8000) == 0)
+				continue;
+
+			bar4 = pci_read_config (0, dev, func, 0x20);
+			if ((bar4 & 1) == 0 || (bar4 & 0xfffc) == 0)
+				continue;
+
+			/* Enable I/O space and bus mastering. */
+			cmd = pci_read_config (0, dev, func, 0x04);
+			pci_write_config (0, dev, func, 0x04, (cmd & 0xffff) | 0x05);
+
+			printf ("hd: bus-master DMA at port 0x%04x (PCI 00:%02x.%d)\n",
+					bar4 & 0xfffc, dev, func);
+			return bar4 & 0xfffc;
+		}
+
+	printf ("hd: no bus-master IDE controller, using PIO\n");
+	return 0;
+}
+
+/* Enables DMA on channel C, whose bus-master registers start at
+   BM_BASE. */
+static void
+setup_dma (struct channel *c, uint16_t bm_base) {
+	c->prdt = palloc_get_page (PAL_ZERO);
+	if (c->prdt == NULL)
+		return;
+	c->bm_base = bm_base;
+	outb (bm_command (c), 0);
+	outb (bm_status (c), BM_STA_DRV0 | BM_STA_DRV1 | BM_STA_ERR | BM_STA_IRQ);
+}
+
+/* Appends entries to channel C's PRD table, which already holds *CNT
+   of them, describing SIZE bytes at BUFFER.  Kernel virtual memory
+   maps physical memory linearly, so the buffer is physically
+   contiguous and only needs to be split at 64 kB boundaries.
+   Returns false if the buffer cannot be used for DMA. */
+static bool
+add_prds (struct channel *c, size_t *cnt, void *buffer, size_t size) {
+	uint64_t paddr;
+
+	if (!is_kernel_vaddr (buffer) || ((uintptr_t) buffer & 1) != 0)
+		return false;
+	paddr = vtop (buffer);
+	if (paddr + size > 0x100000000ULL)
+		return false;
+
+	while (size > 0) {
+		size_t chunk = 0x10000 - (paddr & 0xffff);
+		if (chunk > size)
+			chunk = size;
+		if (*cnt >= PGSIZE / sizeof *c->prdt)
+			return false;
+
+		c->prdt[*cnt].addr = paddr;
+		c->prdt[*cnt].size = chunk & 0xffff;
+		c->prdt[*cnt].flags = 0;
+		paddr += chunk;
+		size -= chunk;
+		(*cnt)++;
+	}
+	return true;
+}
+
+/* Fills channel C's PRD table to scatter or gather the buffers of
+   every request in BATCH.  Returns false if any of them cannot be
+   used for DMA. */
+static bool
+build_prdt (struct channel *c, struct list *batch) {
+	size_t cnt = 0;
+	struct list_elem *e;
+
+	for (e = list_begin (batch); e != list_end (batch); e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		if (!add_prds (c, &cnt, r->buffer, r->cnt * DISK_SECTOR_SIZE))
+			return false;
+	}
+	c->prdt[cnt - 1].flags = PRD_EOT;
+	return true;
+}
+
+/* Moves CNT sectors starting at SEC_NO between disk D and the
+   buffers of BATCH by bus-master DMA, in the direction given by
+   WRITE.  The dispatcher sleeps on completion_wait while the
+   controller moves the data, so other threads can run.  Returns
+   false without touching the disk if DMA is not available for this
+   transfer. */
+static bool
+dma_transfer (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		struct list *batch, bool write) {
+	struct channel *c = d->channel;
+	uint8_t dir = write ? 0 : BM_CMD_READ;
+	uint8_t status;
+
+	if (c->bm_base == 0 || !build_prdt (c, batch))
+		return false;
+
+	outl (bm_prdt (c), vtop (c->prdt));
+	outb (bm_command (c), dir);
+	outb (bm_status (c), inb (bm_status (c)) | BM_STA_ERR | BM_STA_IRQ);
+
+	select_sector (d, sec_no, cnt);
+	issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+	outb (bm_command (c), dir | BM_CMD_START);
+	sema_down (&c->completion_wait);
+	outb (bm_command (c), dir);
+
+	status = inb (bm_status (c));
+	outb (bm_status (c), status | BM_STA_ERR | BM_STA_IRQ);
+	if ((status & BM_STA_ERR) != 0 || (inb (reg_alt_status (c)) & STA_ERR) != 0)
+		PANIC ("%s: DMA %s failed, sector=%"PRDSNu,
+				d->name, write ? "write" : "read", sec_no);
+
+	if (write)
+		d->write_cnt += cnt;
+	else
+		d->read_cnt += cnt;
+	return true;
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 /* 8254 타이머 칩의 하드웨어 세부 사항은 [8254]를 참조하십시오. */
@@ -28,8 +29,47 @@ static int64_t ticks;
 timer_calibrate()에 의해 초기화됩니다. */
 static unsigned loops_per_tick;
 
+/* TSC clocksource, calibrated against the PIT by timer_calibrate().
+   timer_ns() is NS_BASE plus the cycles since TSC_BASE times
+   TSC_MULT, a 32.32 fixed-point count of nanoseconds per cycle.
+   TSC_MULT is 0 until calibration, and timer_ns() falls back to
+   ticks until then. */
+/* PIT 로 보정한 TSC 클록 소스입니다. */
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+#define TSC_CALIBRATE_TICKS 5
+static uint64_t tsc_hz;
+static uint64_t tsc_mult;
+static uint64_t tsc_base;
+static int64_t ns_base;
+
+/* timer_ns() at the most recent tick boundary. */
+static int64_t last_tick_ns;
+
+/* 8254 input frequency, and the count that divides it down to
+   TIMER_FREQ, rounded to nearest. */
+#define PIT_HZ 1193180
+#define TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* If true, the idle thread stops the periodic tick and programs
+   the PIT in one-shot mode up to the next timer event.  Set by the
+   -tickless kernel command line option. */
+bool timer_tickless;
+
+/* While the PIT runs a one-shot countdown started by
+   timer_idle_enter(), the number of ticks it covers; otherwise 0. */
+static int64_t oneshot_ticks;
+static unsigned oneshot_count;  /* Count the countdown started from. */
+static unsigned oneshot_phase;  /* Counts that were left in the tick
+                                   in progress when it started. */
+
+/* Statistics. */
+static long long oneshot_cnt;   /* One-shot countdowns started. */
+static long long skipped_ticks; /* Ticks that raised no interrupt. */
+
 static intr_handler_func timer_interrupt;
+static void pit_set_periodic (void);
 static bool too_many_loops (unsigned loops);
+static void tsc_calibrate (void);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 
@@ -40,17 +80,111 @@ static void real_time_sleep (int64_t num, int32_t denom);
 초당 PIT_FREQ 번 인터럽트하도록 설정하고 해당 인터럽트를 등록합니다. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	/* 8254 입력 주파수를 TIMER_FREQ로 나눈 값입니다. 
-	가장 가까운 값으로 반올림됩니다. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	pit_set_periodic ();
+	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+}
 
+/* Programs counter 0 to interrupt every TICK_COUNT input cycles,
+   that is, TIMER_FREQ times per second. */
+/* 카운터 0이 TICK_COUNT 입력 주기마다, 즉 초당 TIMER_FREQ 번
+   인터럽트하도록 설정합니다. */
+static void
+pit_set_periodic (void) {
 	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, TICK_COUNT & 0xff);
+	outb (0x40, TICK_COUNT >> 8);
+}
+
+/* Starts a one-shot countdown of COUNT input cycles on counter 0.
+   The counter raises its interrupt once, when it reaches zero. */
+static void
+pit_set_oneshot (unsigned count) {
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
 	outb (0x40, count & 0xff);
 	outb (0x40, count >> 8);
+}
 
-	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+/* Returns the current count of counter 0.  Sets *EXPIRED to the
+   state of its output, which in one-shot mode goes high once the
+   countdown has reached zero. */
+static unsigned
+pit_read (bool *expired) {
+	uint8_t status, lo, hi;
+
+	outb (0x43, 0xc2);    /* Read-back: latch count and status of counter 0. */
+	status = inb (0x40);
+	lo = inb (0x40);
+	hi = inb (0x40);
+	*expired = (status & 0x80) != 0;
+	return lo | (hi << 8);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  NEXT is the tick of the next timer event.  If that is
+   more than one tick away, replaces the periodic tick by a single
+   interrupt at NEXT, or as close to it as the 16-bit counter
+   reaches.  Under the MLFQS the periodic tick is kept, since
+   load_avg must be recomputed every second even when idle. */
+void
+timer_idle_enter (int64_t next) {
+	int64_t n;
+	unsigned phase;
+	bool expired;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_tickless || thread_mlfqs || oneshot_ticks != 0)
+		return;
+	n = next - ticks;
+	if (n <= 1)
+		return;
+
+	/* The first of the N ticks ends when the tick in progress does,
+	   PHASE counts from now; each further one takes TICK_COUNT. */
+	phase = pit_read (&expired);
+	if (n - 1 > (0xffff - phase) / TICK_COUNT)
+		n = (0xffff - phase) / TICK_COUNT + 1;
+	if (n <= 1)
+		return;
+
+	oneshot_ticks = n;
+	oneshot_phase = phase;
+	oneshot_count = phase + (n - 1) * TICK_COUNT;
+	pit_set_oneshot (oneshot_count);
+	oneshot_cnt++;
+}
+
+/* Called by the scheduler, with interrupts off, when the idle
+   thread gives up the CPU.  If a one-shot countdown is still
+   running, accounts for the ticks that have passed so far and
+   restarts the periodic tick. */
+void
+timer_idle_exit (void) {
+	unsigned left;
+	bool expired;
+	int64_t passed;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (oneshot_ticks == 0)
+		return;
+
+	left = pit_read (&expired);
+	if (expired) {
+		/* Its interrupt is pending and will count as the last tick. */
+		passed = oneshot_ticks - 1;
+	} else {
+		unsigned elapsed = oneshot_count - left;
+		passed = elapsed < oneshot_phase
+			? 0 : 1 + (elapsed - oneshot_phase) / TICK_COUNT;
+	}
+	ticks += passed;
+	skipped_ticks += passed;
+	thread_idle_ticks (passed);
+
+	oneshot_ticks = 0;
+	pit_set_periodic ();
+	last_tick_ns = timer_ns ();
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -79,7 +213,44 @@ timer_calibrate (void) {
 		if (!too_many_loops (high_bit | test_bit))
 			loops_per_tick |= test_bit;
 
-	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+	tsc_calibrate ();
+
+	printf ("%'"PRIu64" loops/s, %'"PRIu64" TSC cycles/s.\n",
+			(uint64_t) loops_per_tick * TIMER_FREQ, tsc_hz);
+}
+
+/* Measures the TSC frequency by counting cycles over
+   TSC_CALIBRATE_TICKS whole timer ticks. */
+/* TSC_CALIBRATE_TICKS 틱 동안 지나간 TSC 주기를 세어 TSC 주파수를 구합니다. */
+static void
+tsc_calibrate (void) {
+	int64_t start = ticks;
+	uint64_t tsc_start;
+
+	while (ticks == start)
+		barrier ();
+	tsc_start = rdtsc ();
+	start = ticks;
+	while (ticks - start < TSC_CALIBRATE_TICKS)
+		barrier ();
+	tsc_base = rdtsc ();
+	ns_base = ticks * NS_PER_TICK;
+
+	tsc_hz = (tsc_base - tsc_start) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+	if (tsc_hz != 0)
+		tsc_mult = ((uint64_t) 1000000000 << 32) / tsc_hz;
+}
+
+/* Returns the number of nanoseconds since the OS booted, from the
+   TSC once it is calibrated.  Monotonic, and much finer than
+   timer_ticks(), so it is what instrumentation should use. */
+/* 부팅 이후 지난 나노초를 반환합니다. */
+int64_t
+timer_ns (void) {
+	if (tsc_mult == 0)
+		return timer_ticks () * NS_PER_TICK;
+	return ns_base + (int64_t) (((unsigned __int128) (rdtsc () - tsc_base)
+				* tsc_mult) >> 32);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -143,13 +314,33 @@ timer_nsleep (int64_t ns) {
 void
 timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	if (timer_tickless)
+		printf ("Timer: %lld one-shot countdowns, %lld ticks without "
+				"an interrupt\n", oneshot_cnt, skipped_ticks);
 }
 
 /* Timer interrupt handler. */
 /* 타이머 인터럽트 핸들러입니다. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+	bool expired;
+
+	/* An interrupt that arrives while a one-shot countdown runs is
+	   either the countdown expiring, covering ONESHOT_TICKS ticks,
+	   or a periodic one that was already pending when the countdown
+	   started, which the countdown does not include. */
+	if (oneshot_ticks != 0) {
+		pit_read (&expired);
+		if (expired) {
+			ticks += oneshot_ticks - 1;
+			skipped_ticks += oneshot_ticks - 1;
+			thread_idle_ticks (oneshot_ticks - 1);
+			oneshot_ticks = 0;
+			pit_set_periodic ();
+		}
+	}
 	ticks++;
+	last_tick_ns = timer_ns ();
 	thread_tick ();
 
 	/*
@@ -229,14 +420,31 @@ real_time_sleep (int64_t num, int32_t denom) {
 		/* 적어도 한 번의 완전한 타이머 틱을 기다리고 있습니다. 
 		CPU를 다른 프로세스에 양보하기 위해 timer_sleep()을 사용합니다. */
 		timer_sleep (ticks);
-	} else {
-		/* Otherwise, use a busy-wait loop for more accurate
-		   sub-tick timing.  We scale the numerator and denominator
-		   down by 1000 to avoid the possibility of overflow. */
-		/* 그렇지 않은 경우, 보다 정확한 서브 틱 타이밍을 위해 
+	} else if (tsc_mult == 0) {
+		/* Before the TSC is calibrated, use a busy-wait loop for
+		   more accurate sub-tick timing.  We scale the numerator and
+		   denominator down by 1000 to avoid the possibility of
+		   overflow. */
+		/* TSC 보정 전에는 보다 정확한 서브 틱 타이밍을 위해 
 		바쁜 대기 루프를 사용합니다.
 		오버플로우 가능성을 피하기 위해 분자와 분모를 1000으로 축소합니다. */
 		ASSERT (denom % 1000 == 0);
 		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+	} else {
+		/* Otherwise wait on the TSC.  As long as the next tick comes
+		   before the deadline, block until it instead of spinning;
+		   for the rest, yield to any other ready thread. */
+		/* 그렇지 않으면 TSC 로 기다립니다. 다음 틱이 마감 전에 오면
+		   돌지 않고 그 틱까지 잠들고, 나머지 시간에는 다른 스레드에게
+		   양보합니다. */
+		int64_t deadline = timer_ns () + num * (1000000000 / denom);
+
+		ASSERT (1000000000 % denom == 0);
+		while (timer_ns () < deadline) {
+			if (last_tick_ns + NS_PER_TICK <= deadline)
+				timer_sleep (1);
+			else
+				thread_yield ();
+		}
 	}
 }
@@ -0,0 +1,365 @@
+/* buffer_cache.c: Sector-granular cache between inodes and the disk. */
+
+#include "filesys/buffer_cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Write-behind tuning, set from the kernel command line. */
+int64_t buffer_cache_dirty_age = BUFFER_CACHE_DIRTY_AGE;
+int buffer_cache_dirty_ratio = BUFFER_CACHE_DIRTY_RATIO;
+
+/* Longest interval between two passes of the flusher, in ticks. */
+#define FLUSH_PERIOD (TIMER_FREQ / 10)
+
+/* A cached copy of one sector of the file system disk. */
+struct cache_entry {
+	disk_sector_t sector;               /* Cached sector, if VALID. */
+	bool valid;                         /* True if SECTOR is meaningful. */
+	bool dirty;                         /* True if DATA differs from disk. */
+	bool accessed;                      /* Reference bit for the clock. */
+	int64_t dirty_since;                /* Tick at which DIRTY was set. */
+	struct lock lock;                   /* Protects DATA and the flags. */
+	uint8_t data[DISK_SECTOR_SIZE];     /* Sector contents. */
+};
+
+static struct cache_entry cache[BUFFER_CACHE_SIZE];
+
+/* Protects the sector tags and the clock hand.  Never held while
+ * waiting for disk I/O. */
+static struct lock cache_lock;
+static size_t clock_hand;
+
+/* Statistics. */
+static long long hit_cnt;               /* Lookups served from the cache. */
+static long long miss_cnt;              /* Lookups that went to disk. */
+static long long writeback_cnt;         /* Dirty sectors written back. */
+static long long readahead_cnt;         /* Sectors brought in by read-ahead. */
+static long long flush_cnt;             /* Sectors written by the flusher. */
+
+static void buffer_cache_flusher (void *aux);
+
+/* Initializes the buffer cache. */
+void
+buffer_cache_init (void) {
+	size_t i;
+
+	lock_init (&cache_lock);
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++) {
+		cache[i].valid = false;
+		cache[i].dirty = false;
+		cache[i].accessed = false;
+		lock_init (&cache[i].lock);
+	}
+	clock_hand = 0;
+
+	if (thread_create ("bflushd", PRI_DEFAULT, buffer_cache_flusher, NULL)
+			== TID_ERROR)
+		PANIC ("could not start the buffer cache flusher");
+}
+
+/* Returns the entry caching SECTOR, or a null pointer.
+ * Must be called with cache_lock held. */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++)
+		if (cache[i].valid && cache[i].sector == sector)
+			return &cache[i];
+	return NULL;
+}
+
+/* Runs the clock over the cache and returns a locked entry that
+ * has not been referenced since the hand last passed it.  Entries
+ * that are in use by other threads are skipped.  Returns a null
+ * pointer if every entry is busy.
+ * Must be called with cache_lock held. */
+static struct cache_entry *
+cache_select_victim (void) {
+	size_t i;
+
+	/* Two full sweeps: the first may only clear reference bits. */
+	for (i = 0; i < 2 * BUFFER_CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[clock_hand];
+		clock_hand = (clock_hand + 1) % BUFFER_CACHE_SIZE;
+
+		if (!lock_try_acquire (&e->lock))
+			continue;
+		if (e->valid && e->accessed) {
+			e->accessed = false;
+			lock_release (&e->lock);
+			continue;
+		}
+		return e;
+	}
+	return NULL;
+}
+
+/* Returns the entry for SECTOR with its lock held.  If LOAD is
+ * true the entry's data is read from disk on a miss; otherwise the
+ * caller is expected to overwrite the whole sector.  PREFETCH
+ * lookups are counted as read-ahead rather than hits or misses. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool load, bool prefetch) {
+	for (;;) {
+		struct cache_entry *e;
+
+		lock_acquire (&cache_lock);
+		e = cache_lookup (sector);
+		if (e != NULL) {
+			lock_release (&cache_lock);
+			lock_acquire (&e->lock);
+
+			/* The entry may have been recycled while we waited. */
+			if (e->valid && e->sector == sector) {
+				e->accessed = true;
+				if (!prefetch)
+					hit_cnt++;
+				return e;
+			}
+			lock_release (&e->lock);
+			continue;
+		}
+
+		e = cache_select_victim ();
+		if (e == NULL) {
+			lock_release (&cache_lock);
+			thread_yield ();
+			continue;
+		}
+
+		if (e->valid && e->dirty) {
+			/* Write the victim back without holding cache_lock.  The
+			 * entry keeps its old tag until it is clean, so a reader of
+			 * that sector waits on E's lock instead of reading stale
+			 * data from disk.  Then start over, since another thread may
+			 * have brought SECTOR in meanwhile. */
+			lock_release (&cache_lock);
+			disk_write (filesys_disk, e->sector, e->data);
+			e->dirty = false;
+			writeback_cnt++;
+			lock_release (&e->lock);
+			continue;
+		}
+
+		/* Claim the entry for SECTOR before reading it, so that other
+		 * lookups find it and wait on its lock. */
+		e->sector = sector;
+		e->valid = true;
+		e->dirty = false;
+		e->accessed = true;
+		if (prefetch)
+			readahead_cnt++;
+		else
+			miss_cnt++;
+		lock_release (&cache_lock);
+
+		if (load)
+			disk_read (filesys_disk, sector, e->data);
+		return e;
+	}
+}
+
+/* Reads SIZE bytes starting at SECTOR_OFS within SECTOR into
+ * BUFFER, through the cache. */
+void
+buffer_cache_read (disk_sector_t sector, void *buffer, int sector_ofs,
+		int size) {
+	struct cache_entry *e;
+
+	ASSERT (sector_ofs >= 0 && size >= 0);
+	ASSERT (sector_ofs + size <= DISK_SECTOR_SIZE);
+
+	e = cache_get (sector, true, false);
+	memcpy (buffer, e->data + sector_ofs, size);
+	lock_release (&e->lock);
+}
+
+/* Writes SIZE bytes from BUFFER to SECTOR_OFS within SECTOR.  The
+ * data reaches the disk when the entry is evicted or flushed. */
+void
+buffer_cache_write (disk_sector_t sector, const void *buffer,
+		int sector_ofs, int size) {
+	struct cache_entry *e;
+
+	ASSERT (sector_ofs >= 0 && size >= 0);
+	ASSERT (sector_ofs + size <= DISK_SECTOR_SIZE);
+
+	e = cache_get (sector, sector_ofs != 0 || size != DISK_SECTOR_SIZE,
+			false);
+	memcpy (e->data + sector_ofs, buffer, size);
+	if (!e->dirty) {
+		e->dirty = true;
+		e->dirty_since = timer_ticks ();
+	}
+	lock_release (&e->lock);
+}
+
+/* Brings SECTOR into the cache if it is not already there, so that
+ * a later buffer_cache_read() of it does not wait for the disk. */
+void
+buffer_cache_prefetch (disk_sector_t sector) {
+	struct cache_entry *e = cache_get (sector, true, true);
+	lock_release (&e->lock);
+}
+
+/* A dirty entry picked for write-back, with the sector it held
+ * when it was picked. */
+struct flush_slot {
+	struct cache_entry *e;
+	disk_sector_t sector;
+};
+
+/* Collects the dirty entries for which SELECT returns true into
+ * SLOTS, sorted by sector, and returns how many there are.  The
+ * flags are sampled without locks; write_back() rechecks them. */
+static size_t
+collect_dirty (struct flush_slot slots[BUFFER_CACHE_SIZE],
+		bool (*select) (const struct cache_entry *, void *), void *aux) {
+	size_t cnt = 0;
+	size_t i, j;
+
+	/* Insertion sort; there are at most 64 entries. */
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[i];
+		disk_sector_t sector = e->sector;
+
+		if (!e->valid || !e->dirty || !select (e, aux))
+			continue;
+		for (j = cnt; j > 0 && slots[j - 1].sector > sector; j--)
+			slots[j] = slots[j - 1];
+		slots[j].e = e;
+		slots[j].sector = sector;
+		cnt++;
+	}
+	return cnt;
+}
+
+/* Writes back the CNT entries in SLOTS, which are sorted by sector,
+ * so the disk head sweeps in one direction.  Runs of consecutive
+ * sectors are copied into one buffer and written with a single
+ * disk_write_multi().  Every entry of a run stays locked until the
+ * run is on disk, so that an eviction cannot write a newer copy that
+ * our older one then overwrites.  Returns the number of sectors
+ * written. */
+static size_t
+write_back (struct flush_slot *slots, size_t cnt) {
+	uint8_t *run_buf = palloc_get_page (0);
+	size_t max_run = run_buf != NULL ? PGSIZE / DISK_SECTOR_SIZE : 1;
+	size_t written = 0;
+	size_t i = 0;
+
+	while (i < cnt) {
+		struct cache_entry *run[PGSIZE / DISK_SECTOR_SIZE];
+		disk_sector_t first = slots[i].sector;
+		size_t n = 0;
+		size_t j;
+
+		while (i < cnt && n < max_run && slots[i].sector == first + n) {
+			struct cache_entry *e = slots[i++].e;
+
+			/* Only the first lock of a run may block: entries are
+			 * recycled behind our back, so the sampled order does not
+			 * give a safe locking order. */
+			if (n == 0)
+				lock_acquire (&e->lock);
+			else if (!lock_try_acquire (&e->lock)) {
+				/* Retry it as the head of the next run, where the
+				 * lock is taken with lock_acquire(). */
+				i--;
+				break;
+			}
+			if (!e->valid || !e->dirty || e->sector != first + n) {
+				lock_release (&e->lock);
+				break;
+			}
+			run[n++] = e;
+		}
+		if (n == 0)
+			continue;
+
+		if (n == 1)
+			disk_write (filesys_disk, first, run[0]->data);
+		else {
+			for (j = 0; j < n; j++)
+				memcpy (run_buf + j * DISK_SECTOR_SIZE, run[j]->data,
+						DISK_SECTOR_SIZE);
+			disk_write_multi (filesys_disk, first, n, run_buf);
+		}
+		for (j = 0; j < n; j++) {
+			run[j]->dirty = false;
+			lock_release (&run[j]->lock);
+		}
+		written += n;
+	}
+	palloc_free_page (run_buf);
+	return written;
+}
+
+static bool
+select_all (const struct cache_entry *e UNUSED, void *aux UNUSED) {
+	return true;
+}
+
+/* Writes every dirty sector in the cache back to disk. */
+void
+buffer_cache_flush (void) {
+	struct flush_slot slots[BUFFER_CACHE_SIZE];
+	size_t cnt = collect_dirty (slots, select_all, NULL);
+
+	writeback_cnt += write_back (slots, cnt);
+}
+
+static bool
+select_aged (const struct cache_entry *e, void *now_) {
+	int64_t *now = now_;
+	return *now - e->dirty_since >= buffer_cache_dirty_age;
+}
+
+/* Writes back the dirty entries that have been dirty for at least
+ * buffer_cache_dirty_age ticks, or every dirty entry if more than
+ * buffer_cache_dirty_ratio percent of the cache is dirty. */
+static void
+flush_aged (void) {
+	struct flush_slot slots[BUFFER_CACHE_SIZE];
+	int64_t now = timer_ticks ();
+	size_t dirty_cnt = 0;
+	size_t cnt;
+	size_t i;
+
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++)
+		if (cache[i].valid && cache[i].dirty)
+			dirty_cnt++;
+
+	if (dirty_cnt * 100 > (size_t) buffer_cache_dirty_ratio * BUFFER_CACHE_SIZE)
+		cnt = collect_dirty (slots, select_all, NULL);
+	else
+		cnt = collect_dirty (slots, select_aged, &now);
+	flush_cnt += write_back (slots, cnt);
+}
+
+/* Background write-behind thread. */
+static void
+buffer_cache_flusher (void *aux UNUSED) {
+	for (;;) {
+		int64_t period = buffer_cache_dirty_age < FLUSH_PERIOD
+			? buffer_cache_dirty_age : FLUSH_PERIOD;
+		timer_sleep (period > 0 ? period : 1);
+		flush_aged ();
+	}
+}
+
+/* Prints buffer cache statistics. */
+void
+buffer_cache_print_stats (void) {
+	printf ("Buffer cache: %lld hits, %lld misses, %lld read-ahead, "
+			"%lld write-backs, %lld flushed\n",
+			hit_cnt, miss_cnt, readahead_cnt, writeback_cnt, flush_cnt);
+}
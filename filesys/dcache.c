@@ -0,0 +1,194 @@
+/* dcache.c: Cache of directory lookups across path resolutions. */
+
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#include "threads/synch.h"
+
+/* The result of looking up NAME in the directory whose inode is in
+ * sector PARENT: either the sector of NAME's inode, or
+ * DCACHE_NO_ENTRY if there is no such name. */
+struct dentry {
+	struct hash_elem hash_elem;         /* In dentries, if in use. */
+	struct list_elem lru_elem;          /* In lru or free_dentries. */
+	disk_sector_t parent;               /* Directory's inode sector. */
+	char name[NAME_MAX + 1];            /* Null terminated file name. */
+	disk_sector_t sector;               /* NAME's inode sector. */
+};
+
+static struct dentry pool[DCACHE_SIZE];
+static struct hash dentries;            /* Entries in use. */
+static struct list lru;                 /* Entries in use, most recent first. */
+static struct list free_dentries;       /* Entries not in use. */
+static struct lock dcache_lock;         /* Protects all of the above. */
+
+/* Statistics. */
+static long long hit_cnt;               /* Lookups that found a file. */
+static long long negative_cnt;          /* Lookups that found no file. */
+static long long miss_cnt;              /* Lookups left to the directory. */
+
+static uint64_t
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+	return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void) {
+	size_t i;
+
+	if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+		PANIC ("dcache creation failed");
+	list_init (&lru);
+	list_init (&free_dentries);
+	for (i = 0; i < DCACHE_SIZE; i++)
+		list_push_back (&free_dentries, &pool[i].lru_elem);
+	lock_init (&dcache_lock);
+}
+
+/* Returns the entry for NAME in PARENT, or a null pointer.
+ * Must be called with dcache_lock held. */
+static struct dentry *
+dentry_find (disk_sector_t parent, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dentries, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Looks up NAME in the directory whose inode is in sector PARENT.
+ * On a hit, returns true and sets *INODEP to the opened inode for
+ * NAME, or to a null pointer if NAME is known not to exist.
+ * Returns false if the cache does not know NAME.
+ *
+ * The inode is opened without dcache_lock held, since inode_open()
+ * may read the disk.  NAME may be removed in the meantime, and its
+ * sector freed and given to a new inode, so the entry is checked
+ * again once the inode is open.  Even if the entry still names the
+ * same sector, the inode may have been read before the new inode was
+ * written there; inode_create() marks such an inode stale, and it
+ * counts as a miss. */
+bool
+dcache_lookup (disk_sector_t parent, const char *name,
+		struct inode **inodep) {
+	struct dentry *d;
+	disk_sector_t sector;
+	struct inode *inode;
+
+	if (strlen (name) > NAME_MAX)
+		return false;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d == NULL) {
+		miss_cnt++;
+		lock_release (&dcache_lock);
+		return false;
+	}
+	list_remove (&d->lru_elem);
+	list_push_front (&lru, &d->lru_elem);
+	sector = d->sector;
+	if (sector == DCACHE_NO_ENTRY) {
+		negative_cnt++;
+		lock_release (&dcache_lock);
+		*inodep = NULL;
+		return true;
+	}
+	lock_release (&dcache_lock);
+
+	inode = inode_open (sector);
+	if (inode == NULL)
+		return false;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d == NULL || d->sector != sector || inode_is_stale (inode)) {
+		miss_cnt++;
+		lock_release (&dcache_lock);
+		inode_close (inode);
+		return false;
+	}
+	hit_cnt++;
+	lock_release (&dcache_lock);
+	*inodep = inode;
+	return true;
+}
+
+/* Records that NAME in the directory whose inode is in sector PARENT
+ * has its inode in SECTOR, or does not exist if SECTOR is
+ * DCACHE_NO_ENTRY.  Evicts the least recently used entry if the
+ * cache is full.  The caller must hold the directory locked, so that
+ * the directory cannot change between its lookup and this call. */
+void
+dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d != NULL)
+		list_remove (&d->lru_elem);
+	else {
+		if (!list_empty (&free_dentries))
+			d = list_entry (list_pop_front (&free_dentries),
+					struct dentry, lru_elem);
+		else {
+			d = list_entry (list_pop_back (&lru), struct dentry, lru_elem);
+			hash_delete (&dentries, &d->hash_elem);
+		}
+		d->parent = parent;
+		strlcpy (d->name, name, sizeof d->name);
+		hash_insert (&dentries, &d->hash_elem);
+	}
+	d->sector = sector;
+	list_push_front (&lru, &d->lru_elem);
+	lock_release (&dcache_lock);
+}
+
+/* Forgets what is known about NAME in the directory whose inode is
+ * in sector PARENT.  Called whenever that name is added or removed. */
+void
+dcache_invalidate (disk_sector_t parent, const char *name) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d != NULL) {
+		hash_delete (&dentries, &d->hash_elem);
+		list_remove (&d->lru_elem);
+		list_push_front (&free_dentries, &d->lru_elem);
+	}
+	lock_release (&dcache_lock);
+}
+
+/* Prints directory entry cache statistics. */
+void
+dcache_print_stats (void) {
+	printf ("Dentry cache: %lld hits, %lld negative hits, %lld misses\n",
+			hit_cnt, negative_cnt, miss_cnt);
+}
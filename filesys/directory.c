@@ -1,7 +1,9 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -19,6 +21,35 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* In-memory name index of a directory.  On disk a directory is
+ * still a flat array of struct dir_entry; the index is built from it
+ * the first time the directory is searched and then kept up to date
+ * by dir_add() and dir_remove(), so neither lookups nor insertions
+ * need to scan the entries.  It hangs off the directory's inode, so
+ * every struct dir open on that inode shares it. */
+struct dir_index {
+	struct hash names;                  /* dir_name elements. */
+	struct list free_slots;             /* free_slot elements. */
+	off_t end;                          /* Offset past the last entry. */
+};
+
+/* An in-use entry of an indexed directory. */
+struct dir_name {
+	struct hash_elem elem;              /* In dir_index's NAMES. */
+	off_t ofs;                          /* Offset of the entry. */
+	disk_sector_t inode_sector;         /* Sector number of header. */
+	char name[NAME_MAX + 1];            /* Null terminated file name. */
+};
+
+/* An unused entry of an indexed directory. */
+struct free_slot {
+	struct list_elem elem;              /* In dir_index's FREE_SLOTS. */
+	off_t ofs;                          /* Offset of the entry. */
+};
+
+/* Number of entries read at once while building an index. */
+#define INDEX_BATCH 32
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -73,6 +104,133 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+static uint64_t
+dir_name_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_string (hash_entry (e, struct dir_name, elem)->name);
+}
+
+static bool
+dir_name_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return strcmp (hash_entry (a, struct dir_name, elem)->name,
+			hash_entry (b, struct dir_name, elem)->name) < 0;
+}
+
+static void
+dir_name_destroy (struct hash_elem *e, void *aux UNUSED) {
+	free (hash_entry (e, struct dir_name, elem));
+}
+
+/* Frees INDEX_, a struct dir_index. */
+static void
+index_destroy (void *index_) {
+	struct dir_index *index = index_;
+
+	hash_destroy (&index->names, dir_name_destroy);
+	while (!list_empty (&index->free_slots))
+		free (list_entry (list_pop_front (&index->free_slots),
+					struct free_slot, elem));
+	free (index);
+}
+
+/* Records the in-use entry E at OFS in INDEX.  Returns false if out
+ * of memory. */
+static bool
+index_add (struct dir_index *index, const struct dir_entry *e, off_t ofs) {
+	struct dir_name *n = malloc (sizeof *n);
+	if (n == NULL)
+		return false;
+	n->ofs = ofs;
+	n->inode_sector = e->inode_sector;
+	strlcpy (n->name, e->name, sizeof n->name);
+	hash_insert (&index->names, &n->elem);
+	return true;
+}
+
+/* Records that the entry at OFS in INDEX is unused.  Returns false
+ * if out of memory. */
+static bool
+index_add_free (struct dir_index *index, off_t ofs) {
+	struct free_slot *f = malloc (sizeof *f);
+	if (f == NULL)
+		return false;
+	f->ofs = ofs;
+	list_push_front (&index->free_slots, &f->elem);
+	return true;
+}
+
+/* Returns the entry named NAME in INDEX, or a null pointer. */
+static struct dir_name *
+index_find (struct dir_index *index, const char *name) {
+	struct dir_name key;
+	struct hash_elem *e;
+
+	if (strlen (name) > NAME_MAX)
+		return NULL;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&index->names, &key.elem);
+	return e != NULL ? hash_entry (e, struct dir_name, elem) : NULL;
+}
+
+/* Builds the name index of DIR from its entries on disk. */
+static struct dir_index *
+index_build (const struct dir *dir) {
+	struct dir_index *index = malloc (sizeof *index);
+	struct dir_entry *batch = malloc (INDEX_BATCH * sizeof *batch);
+	bool ok = index != NULL && batch != NULL
+		&& hash_init (&index->names, dir_name_hash, dir_name_less, NULL);
+	off_t ofs = 0;
+
+	if (!ok) {
+		free (index);
+		free (batch);
+		return NULL;
+	}
+	list_init (&index->free_slots);
+
+	while (ok) {
+		off_t n = inode_read_at (dir->inode, batch,
+				INDEX_BATCH * sizeof *batch, ofs) / sizeof *batch;
+		off_t i;
+
+		for (i = 0; ok && i < n; i++, ofs += sizeof *batch)
+			ok = batch[i].in_use ? index_add (index, &batch[i], ofs)
+				: index_add_free (index, ofs);
+		if (n < INDEX_BATCH)
+			break;
+	}
+	free (batch);
+
+	if (!ok) {
+		index_destroy (index);
+		return NULL;
+	}
+	index->end = ofs;
+	return index;
+}
+
+/* Returns the name index of DIR, building it if necessary.  Returns
+ * a null pointer if there is not enough memory for it, in which case
+ * callers fall back to scanning the entries. */
+static struct dir_index *
+get_index (const struct dir *dir) {
+	struct dir_index *index = inode_get_private (dir->inode);
+
+	if (index == NULL) {
+		index = index_build (dir);
+		if (index != NULL)
+			inode_set_private (dir->inode, index, index_destroy);
+	}
+	return index;
+}
+
+/* Throws away the name index of DIR after it could not be updated.
+ * It is rebuilt from disk on the next lookup. */
+static void
+discard_index (const struct dir *dir) {
+	inode_set_private (dir->inode, NULL, NULL);
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
@@ -81,12 +239,28 @@ dir_get_inode (struct dir *dir) {
 static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
+	struct dir_index *index;
 	struct dir_entry e;
 	size_t ofs;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	index = get_index (dir);
+	if (index != NULL) {
+		struct dir_name *n = index_find (index, name);
+		if (n == NULL)
+			return false;
+		if (ep != NULL) {
+			ep->inode_sector = n->inode_sector;
+			strlcpy (ep->name, n->name, sizeof ep->name);
+			ep->in_use = true;
+		}
+		if (ofsp != NULL)
+			*ofsp = n->ofs;
+		return true;
+	}
+
 	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 			ofs += sizeof e)
 		if (e.in_use && !strcmp (name, e.name)) {
@@ -106,15 +280,24 @@ lookup (const struct dir *dir, const char *name,
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
+	disk_sector_t parent;
 	struct dir_entry e;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
-	else
-		*inode = NULL;
+	parent = inode_get_inumber (dir->inode);
+	inode_lock_dir (dir->inode);
+	if (!dcache_lookup (parent, name, inode)) {
+		if (lookup (dir, name, &e, NULL)) {
+			dcache_insert (parent, name, e.inode_sector);
+			*inode = inode_open (e.inode_sector);
+		} else {
+			dcache_insert (parent, name, DCACHE_NO_ENTRY);
+			*inode = NULL;
+		}
+	}
+	inode_unlock_dir (dir->inode);
 
 	return *inode != NULL;
 }
@@ -133,6 +316,8 @@ NAME이 유효하지 않은 경우(즉, 너무 긴 경우)나
 디스크 또는 메모리 오류가 발생한 경우 실패합니다. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
+	struct dir_index *index;
+	struct free_slot *slot = NULL;
 	struct dir_entry e;
 	off_t ofs;
 	bool success = false;
@@ -145,6 +330,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 		return false;
 
 	/* Check that NAME is not in use. */
+	inode_lock_dir (dir->inode);
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
 
@@ -154,19 +340,46 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 
 	 * inode_read_at() will only return a short read at end of file.
 	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
+	 * read due to something intermittent such as low memory.
+	 * An indexed directory knows its free slots and its end. */
+	index = get_index (dir);
+	if (index != NULL) {
+		if (!list_empty (&index->free_slots)) {
+			slot = list_entry (list_pop_front (&index->free_slots),
+					struct free_slot, elem);
+			ofs = slot->ofs;
+		} else
+			ofs = index->end;
+	} else
+		for (ofs = 0;
+				inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+				ofs += sizeof e)
+			if (!e.in_use)
+				break;
 
 	/* Write slot. */
 	e.in_use = true;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+	/* Bring the index up to date. */
+	if (index != NULL) {
+		if (!success) {
+			if (slot != NULL)
+				list_push_front (&index->free_slots, &slot->elem);
+			goto done;
+		}
+		free (slot);
+		if (ofs == index->end)
+			index->end += sizeof e;
+		if (!index_add (index, &e, ofs))
+			discard_index (dir);
+	}
 
 done:
+	inode_unlock_dir (dir->inode);
 	return success;
 }
 
@@ -175,6 +388,7 @@ done:
  * which occurs only if there is no file with the given NAME. */
 bool
 dir_remove (struct dir *dir, const char *name) {
+	struct dir_index *index;
 	struct dir_entry e;
 	struct inode *inode = NULL;
 	bool success = false;
@@ -184,6 +398,7 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (name != NULL);
 
 	/* Find directory entry. */
+	inode_lock_dir (dir->inode);
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
 
@@ -196,12 +411,26 @@ dir_remove (struct dir *dir, const char *name) {
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+	/* Bring the index up to date. */
+	index = inode_get_private (dir->inode);
+	if (index != NULL) {
+		struct dir_name *n = index_find (index, name);
+		if (n != NULL) {
+			hash_delete (&index->names, &n->elem);
+			free (n);
+		}
+		if (n == NULL || !index_add_free (index, ofs))
+			discard_index (dir);
+	}
 
 	/* Remove inode. */
 	inode_remove (inode);
 	success = true;
 
 done:
+	inode_unlock_dir (dir->inode);
 	inode_close (inode);
 	return success;
 }
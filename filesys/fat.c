@@ -1,11 +1,19 @@
 #include "filesys/fat.h"
 #include "devices/disk.h"
+#include "devices/timer.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <bitmap.h>
 #include <stdio.h>
 #include <string.h>
 
+/* Interval between two passes of the FAT flusher, in ticks. */
+#define FAT_FLUSH_PERIOD TIMER_FREQ
+
 /* Should be less than DISK_SECTOR_SIZE */
 struct fat_boot {
 	unsigned int magic;
@@ -22,11 +30,22 @@ struct fat_fs {
 	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
+	cluster_t last_clst;            /* Where to look for a free cluster. */
+	cluster_t free_cnt;             /* Number of free clusters. */
 	struct lock write_lock;
+	struct bitmap *dirty;           /* FAT sectors changed since written. */
+	struct lock flush_lock;         /* Serializes fat_flush(). */
 };
 
 static struct fat_fs *fat_fs;
+static tid_t fat_flusher_tid = TID_ERROR;
+
+/* Statistics. */
+static long long flush_cnt;             /* Flushes that wrote something. */
+static long long flushed_sectors;       /* FAT sectors written by them. */
+static size_t last_flush_sectors;       /* Written by the latest one. */
+
+static void fat_flusher (void *aux);
 
 void fat_boot_create (void);
 void fat_fs_init (void);
@@ -51,32 +70,137 @@ fat_init (void) {
 	fat_fs_init ();
 }
 
+/* Counts the free clusters, for fat_create_chain(). */
+static void
+fat_count_free (void) {
+	cluster_t clst;
+
+	fat_fs->free_cnt = 0;
+	for (clst = ROOT_DIR_CLUSTER; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] == 0)
+			fat_fs->free_cnt++;
+}
+
+/* Creates the dirty bitmap with every FAT sector marked DIRTY. */
+static void
+fat_dirty_init (bool dirty) {
+	if (fat_fs->dirty != NULL)
+		bitmap_destroy (fat_fs->dirty);
+	fat_fs->dirty = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->dirty == NULL)
+		PANIC ("FAT dirty map creation failed");
+	bitmap_set_all (fat_fs->dirty, dirty);
+}
+
+/* Sets the FAT entry for CLST to VAL and marks its sector dirty. */
+static void
+fat_set (cluster_t clst, cluster_t val) {
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	fat_fs->fat[clst] = val;
+	bitmap_mark (fat_fs->dirty,
+			clst / (DISK_SECTOR_SIZE / sizeof (cluster_t)));
+}
+
 void
 fat_open (void) {
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
 
-	// Load FAT directly from the disk
+	// Load FAT directly from the disk: every whole sector in one
+	// transfer, then the partial last sector through a bounce buffer.
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
+	const size_t full_sectors = fat_size_in_bytes / DISK_SECTOR_SIZE;
+	const off_t bytes_left = fat_size_in_bytes % DISK_SECTOR_SIZE;
+	if (full_sectors > 0)
+		disk_read_multi (filesys_disk, fat_fs->bs.fat_start, full_sectors,
+		                 buffer);
+	if (bytes_left > 0) {
+		uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC ("FAT load failed");
+		disk_read (filesys_disk, fat_fs->bs.fat_start + full_sectors, bounce);
+		memcpy (buffer + full_sectors * DISK_SECTOR_SIZE, bounce, bytes_left);
+		free (bounce);
+	}
+	fat_count_free ();
+	fat_dirty_init (false);
+
+	if (fat_flusher_tid == TID_ERROR) {
+		fat_flusher_tid = thread_create ("fatflushd", PRI_DEFAULT,
+				fat_flusher, NULL);
+		if (fat_flusher_tid == TID_ERROR)
+			PANIC ("could not start the FAT flusher");
+	}
+}
+
+/* Writes the FAT sectors that changed since they were last written.
+ * Runs of consecutive dirty sectors are copied out under the write
+ * lock and written with one disk_write_multi() each, so allocation
+ * is not held up by the disk.  Returns the number of sectors
+ * written. */
+size_t
+fat_flush (void) {
+	const size_t per_page = PGSIZE / DISK_SECTOR_SIZE;
+	const size_t fat_bytes = fat_fs->fat_length * sizeof (cluster_t);
+	uint8_t *buffer;
+	size_t written = 0;
+	size_t sector = 0;
+
+	buffer = palloc_get_page (0);
+	if (buffer == NULL)
+		PANIC ("FAT flush failed");
+
+	lock_acquire (&fat_fs->flush_lock);
+	for (;;) {
+		size_t cnt = 0;
+
+		lock_acquire (&fat_fs->write_lock);
+		sector = bitmap_scan (fat_fs->dirty, sector, 1, true);
+		if (sector != BITMAP_ERROR)
+			while (cnt < per_page && sector + cnt < fat_fs->bs.fat_sectors
+					&& bitmap_test (fat_fs->dirty, sector + cnt)) {
+				size_t ofs = (sector + cnt) * DISK_SECTOR_SIZE;
+				size_t len = ofs < fat_bytes ? fat_bytes - ofs : 0;
+
+				if (len > DISK_SECTOR_SIZE)
+					len = DISK_SECTOR_SIZE;
+				memcpy (buffer + cnt * DISK_SECTOR_SIZE,
+						(uint8_t *) fat_fs->fat + ofs, len);
+				memset (buffer + cnt * DISK_SECTOR_SIZE + len, 0,
+						DISK_SECTOR_SIZE - len);
+				bitmap_reset (fat_fs->dirty, sector + cnt);
+				cnt++;
+			}
+		lock_release (&fat_fs->write_lock);
+		if (sector == BITMAP_ERROR)
+			break;
+
+		disk_write_multi (filesys_disk, fat_fs->bs.fat_start + sector, cnt,
+				buffer);
+		written += cnt;
+		sector += cnt;
+	}
+	if (written > 0) {
+		flush_cnt++;
+		flushed_sectors += written;
+		last_flush_sectors = written;
+	}
+	lock_release (&fat_fs->flush_lock);
+
+	palloc_free_page (buffer);
+	return written;
+}
+
+/* Background thread that writes out changed FAT sectors, so that a
+ * crash loses at most FAT_FLUSH_PERIOD ticks of allocations. */
+static void
+fat_flusher (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (FAT_FLUSH_PERIOD);
+		fat_flush ();
 	}
 }
 
@@ -90,27 +214,8 @@ fat_close (void) {
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
-		}
-	}
+	// Write whatever part of the FAT changed since the last flush.
+	fat_flush ();
 }
 
 void
@@ -123,9 +228,12 @@ fat_create (void) {
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_count_free ();
+	fat_dirty_init (true);
 
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
+	fat_fs->free_cnt--;
 
 	// Fill up ROOT_DIR_CLUSTER region with 0
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
@@ -150,9 +258,28 @@ fat_boot_create (void) {
 	};
 }
 
+/* Derives the in-memory layout from the boot sector.  Entry 0 of
+ * the FAT is reserved, since cluster 0 means "no cluster"; cluster 1
+ * is the first one after the FAT. */
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ fat_fs->bs.sectors_per_cluster + 1;
+	ASSERT (fat_fs->fat_length
+			<= fat_fs->bs.fat_sectors * (DISK_SECTOR_SIZE / sizeof (cluster_t)));
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+	fat_fs->free_cnt = 0;
+	lock_init (&fat_fs->write_lock);
+	lock_init (&fat_fs->flush_lock);
+}
+
+/* Prints free space on the FAT file system. */
+void
+fat_print_stats (void) {
+	printf ("FAT: %u of %u clusters free, %lld sectors written in %lld "
+			"flushes (last %zu)\n", fat_fs->free_cnt, fat_fs->fat_length - 1,
+			flushed_sectors, flush_cnt, last_flush_sectors);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -164,30 +291,75 @@ fat_fs_init (void) {
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	cluster_t new_clst = 0;
+	cluster_t i;
+
+	lock_acquire (&fat_fs->write_lock);
+	/* Search from the last cluster handed out, so that a chain
+	 * grows into consecutive clusters and the search does not
+	 * start over from the beginning of the FAT every time. */
+	for (i = 0; fat_fs->free_cnt > 0 && i < fat_fs->fat_length - 1; i++) {
+		cluster_t c = (fat_fs->last_clst - 1 + i) % (fat_fs->fat_length - 1) + 1;
+		if (fat_fs->fat[c] == 0) {
+			new_clst = c;
+			break;
+		}
+	}
+	if (new_clst != 0) {
+		fat_set (new_clst, EOChain);
+		if (clst != 0)
+			fat_set (clst, new_clst);
+		fat_fs->last_clst = new_clst;
+		fat_fs->free_cnt--;
+	}
+	lock_release (&fat_fs->write_lock);
+	return new_clst;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		fat_set (pclst, EOChain);
+	while (clst != EOChain) {
+		cluster_t next;
+
+		ASSERT (clst > 0 && clst < fat_fs->fat_length);
+		next = fat_fs->fat[clst];
+		fat_set (clst, 0);
+		fat_fs->free_cnt++;
+		clst = next;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	fat_set (clst, val);
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->data_start + (clst - 1) * fat_fs->bs.sectors_per_cluster;
+}
+
+/* Converts a sector number back to the cluster that holds it. */
+cluster_t
+sector_to_cluster (disk_sector_t sector) {
+	ASSERT (sector >= fat_fs->data_start);
+	return (sector - fat_fs->data_start) / fat_fs->bs.sectors_per_cluster + 1;
 }
@@ -1,6 +1,7 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
 
 /* An open file. */
@@ -8,6 +9,7 @@ struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? *//* file_deny_write() 함수가 호출되었는지 확인되었나요? */
+	struct readahead ra;        /* Sequential access tracking. */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -78,6 +80,7 @@ FILE로부터 현재 위치에서 시작하여 SIZE 바이트를 BUFFER로 읽
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	page_cache_access (&file->ra, file->inode, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -1,12 +1,220 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct lock free_map_lock;    /* Protects the map and its index. */
+
+/* The bitmap is the on-disk format.  In memory, its runs of free
+ * sectors are also indexed as extents: by first sector and by end
+ * sector, so that a released run coalesces with its neighbors in
+ * constant time, and by size class, so that allocation looks at only
+ * a few lists instead of scanning the bitmap. */
+struct extent {
+	disk_sector_t start;                /* First free sector. */
+	size_t cnt;                         /* Number of free sectors. */
+	struct hash_elem start_elem;        /* In by_start, keyed by START. */
+	struct hash_elem end_elem;          /* In by_end, keyed by START + CNT. */
+	struct list_elem class_elem;        /* In size_classes[]. */
+};
+
+/* Extent sizes in [2**i, 2**(i+1)) are kept in size_classes[i]. */
+#define CLASS_CNT 32
+
+static struct hash by_start;
+static struct hash by_end;
+static struct list size_classes[CLASS_CNT];
+
+/* Returns floor(log2(CNT)). */
+static int
+size_class (size_t cnt) {
+	int class = 0;
+
+	ASSERT (cnt > 0);
+	while (cnt >>= 1)
+		class++;
+	return class < CLASS_CNT ? class : CLASS_CNT - 1;
+}
+
+static uint64_t
+start_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct extent *x = hash_entry (e, struct extent, start_elem);
+	return hash_int (x->start);
+}
+
+static bool
+start_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct extent, start_elem)->start
+		< hash_entry (b, struct extent, start_elem)->start;
+}
+
+static uint64_t
+end_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct extent *x = hash_entry (e, struct extent, end_elem);
+	return hash_int (x->start + x->cnt);
+}
+
+static bool
+end_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	const struct extent *x = hash_entry (a, struct extent, end_elem);
+	const struct extent *y = hash_entry (b, struct extent, end_elem);
+	return x->start + x->cnt < y->start + y->cnt;
+}
+
+/* Adds extent X to the indexes. */
+static void
+extent_insert (struct extent *x) {
+	hash_insert (&by_start, &x->start_elem);
+	hash_insert (&by_end, &x->end_elem);
+	list_push_front (&size_classes[size_class (x->cnt)], &x->class_elem);
+}
+
+/* Removes extent X from the indexes. */
+static void
+extent_remove (struct extent *x) {
+	hash_delete (&by_start, &x->start_elem);
+	hash_delete (&by_end, &x->end_elem);
+	list_remove (&x->class_elem);
+}
+
+/* Returns the free extent that starts at SECTOR, if any. */
+static struct extent *
+extent_starting_at (disk_sector_t sector) {
+	struct extent key;
+	struct hash_elem *e;
+
+	key.start = sector;
+	e = hash_find (&by_start, &key.start_elem);
+	return e != NULL ? hash_entry (e, struct extent, start_elem) : NULL;
+}
+
+/* Returns the free extent that ends just before SECTOR, if any. */
+static struct extent *
+extent_ending_at (disk_sector_t sector) {
+	struct extent key;
+	struct hash_elem *e;
+
+	key.start = sector;
+	key.cnt = 0;
+	e = hash_find (&by_end, &key.end_elem);
+	return e != NULL ? hash_entry (e, struct extent, end_elem) : NULL;
+}
+
+/* Returns the smallest-class free extent of at least CNT sectors,
+ * or a null pointer if there is none. */
+static struct extent *
+extent_fit (size_t cnt) {
+	int class = size_class (cnt);
+	struct list_elem *e;
+
+	/* Extents in CNT's own class may be too short. */
+	for (e = list_begin (&size_classes[class]);
+			e != list_end (&size_classes[class]); e = list_next (e)) {
+		struct extent *x = list_entry (e, struct extent, class_elem);
+		if (x->cnt >= cnt)
+			return x;
+	}
+	/* Any extent in a larger class will do. */
+	for (class++; class < CLASS_CNT; class++)
+		if (!list_empty (&size_classes[class]))
+			return list_entry (list_front (&size_classes[class]),
+					struct extent, class_elem);
+	return NULL;
+}
+
+/* Marks CNT sectors starting at SECTOR free in the extent index,
+ * merging them with the free extents on either side. */
+static void
+extent_release (disk_sector_t sector, size_t cnt) {
+	struct extent *prev = extent_ending_at (sector);
+	struct extent *next = extent_starting_at (sector + cnt);
+
+	if (prev != NULL) {
+		extent_remove (prev);
+		prev->cnt += cnt;
+		if (next != NULL) {
+			extent_remove (next);
+			prev->cnt += next->cnt;
+			free (next);
+		}
+		extent_insert (prev);
+	} else if (next != NULL) {
+		extent_remove (next);
+		next->start = sector;
+		next->cnt += cnt;
+		extent_insert (next);
+	} else {
+		struct extent *x = malloc (sizeof *x);
+		if (x == NULL)
+			PANIC ("out of memory for the free extent index");
+		x->start = sector;
+		x->cnt = cnt;
+		extent_insert (x);
+	}
+}
+
+/* Takes the first CNT sectors of free extent X. */
+static disk_sector_t
+extent_take (struct extent *x, size_t cnt) {
+	disk_sector_t sector = x->start;
+
+	ASSERT (x->cnt >= cnt);
+	extent_remove (x);
+	x->start += cnt;
+	x->cnt -= cnt;
+	if (x->cnt > 0)
+		extent_insert (x);
+	else
+		free (x);
+	return sector;
+}
+
+static void
+extent_destroy (struct hash_elem *e, void *aux UNUSED) {
+	free (hash_entry (e, struct extent, start_elem));
+}
+
+/* Discards the extent index and rebuilds it from the bitmap. */
+static void
+build_extents (void) {
+	size_t size = bitmap_size (free_map);
+	size_t sector = 0;
+	int class;
+
+	if (by_start.buckets != NULL) {
+		hash_destroy (&by_end, NULL);
+		hash_destroy (&by_start, extent_destroy);
+	}
+	if (!hash_init (&by_start, start_hash, start_less, NULL))
+		PANIC ("free extent index creation failed");
+	hash_init (&by_end, end_hash, end_less, NULL);
+	for (class = 0; class < CLASS_CNT; class++)
+		list_init (&size_classes[class]);
+
+	while (sector < size) {
+		size_t start = bitmap_scan (free_map, sector, 1, false);
+		size_t end;
+
+		if (start == BITMAP_ERROR)
+			break;
+		end = bitmap_scan (free_map, start, 1, true);
+		if (end == BITMAP_ERROR)
+			end = size;
+		extent_release (start, end - start);
+		sector = end;
+	}
+}
 
 /* Initializes the free map. */
 void
@@ -16,6 +224,8 @@ free_map_init (void) {
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	lock_init (&free_map_lock);
+	build_extents ();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,24 +234,89 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
+	return free_map_allocate_near (cnt, 0, sectorp);
+}
+
+/* Like free_map_allocate(), but prefers the run that starts at HINT,
+ * typically the sector just past a growing file's last block, so
+ * that the file stays contiguous on disk. */
+bool
+free_map_allocate_near (size_t cnt, disk_sector_t hint,
+		disk_sector_t *sectorp) {
+	struct extent *x = NULL;
+	disk_sector_t sector;
+
+	ASSERT (cnt > 0);
+	lock_acquire (&free_map_lock);
+	if (hint != 0)
+		x = extent_starting_at (hint);
+	if (x == NULL || x->cnt < cnt)
+		x = extent_fit (cnt);
+	if (x == NULL) {
+		lock_release (&free_map_lock);
+		return false;
+	}
+
+	sector = extent_take (x, cnt);
+	ASSERT (!bitmap_contains (free_map, sector, cnt, true));
+	bitmap_set_multiple (free_map, sector, cnt, true);
+	if (free_map_file != NULL && !bitmap_write (free_map, free_map_file)) {
 		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+		extent_release (sector, cnt);
+		lock_release (&free_map_lock);
+		return false;
 	}
-	if (sector != BITMAP_ERROR)
-		*sectorp = sector;
-	return sector != BITMAP_ERROR;
+	lock_release (&free_map_lock);
+	*sectorp = sector;
+	return true;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
 	bitmap_set_multiple (free_map, sector, cnt, false);
+	extent_release (sector, cnt);
 	bitmap_write (free_map, free_map_file);
+	lock_release (&free_map_lock);
+}
+
+/* Prints free space and fragmentation statistics. */
+void
+free_map_print_stats (void) {
+	size_t free_cnt = 0, extent_cnt = 0, largest = 0;
+	struct hash_iterator i;
+	int class;
+
+	if (free_map == NULL) {
+		printf ("free map not in use\n");
+		return;
+	}
+
+	lock_acquire (&free_map_lock);
+	hash_first (&i, &by_start);
+	while (hash_next (&i)) {
+		struct extent *x = hash_entry (hash_cur (&i), struct extent,
+				start_elem);
+		free_cnt += x->cnt;
+		extent_cnt++;
+		if (x->cnt > largest)
+			largest = x->cnt;
+	}
+
+	printf ("%zu of %zu sectors free in %zu extents, largest %zu",
+			free_cnt, bitmap_size (free_map), extent_cnt, largest);
+	if (free_cnt > 0)
+		printf (", %zu%% fragmented", 100 - largest * 100 / free_cnt);
+	printf ("\n");
+	for (class = 0; class < CLASS_CNT; class++) {
+		size_t n = list_size (&size_classes[class]);
+		if (n > 0)
+			printf ("  %zu-%zu sectors: %zu extents\n", (size_t) 1 << class,
+					((size_t) 2 << class) - 1, n);
+	}
+	lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -52,6 +327,7 @@ free_map_open (void) {
 		PANIC ("can't open free map");
 	if (!bitmap_read (free_map, free_map_file))
 		PANIC ("can't read free map");
+	build_extents ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -6,6 +6,7 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "devices/disk.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
@@ -196,3 +197,14 @@ fsutil_get (char **argv) {
 	file_close (src);
 	free (buffer);
 }
+
+/* Prints free space and fragmentation of the file system disk. */
+void
+fsutil_df (char **argv UNUSED) {
+	printf ("Free space on the file system disk:\n");
+#ifdef EFILESYS
+	fat_print_stats ();
+#else
+	free_map_print_stats ();
+#endif
+}
@@ -1,23 +1,53 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+#ifdef EFILESYS
 /* On-disk inode.
+ * Data occupies the FAT cluster chain that begins at START, or no
+ * clusters at all if START is 0.
  * Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
+	cluster_t start;                    /* First data cluster. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
 	uint32_t unused[125];               /* Not used. */
 };
+#else
+/* Number of sector pointers held in the inode itself and in one
+ * index block. */
+#define DIRECT_CNT 124
+#define PTRS_PER_SECTOR (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+
+/* Largest number of data sectors an inode can address. */
+#define MAX_SECTORS (DIRECT_CNT + PTRS_PER_SECTOR \
+		+ PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+
+/* On-disk inode.
+ * Data sectors are reached through DIRECT, then through the index
+ * block INDIRECT, then through the two-level index DOUBLY_INDIRECT.
+ * A zero pointer is a hole that reads as zeros; sector 0 holds the
+ * free map and can never be a data sector.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct inode_disk {
+	off_t length;                       /* File size in bytes. */
+	unsigned magic;                     /* Magic number. */
+	disk_sector_t direct[DIRECT_CNT];   /* Direct data sectors. */
+	disk_sector_t indirect;             /* Index block of data sectors. */
+	disk_sector_t doubly_indirect;      /* Index block of index blocks. */
+};
+#endif /* EFILESYS */
 
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
@@ -28,35 +58,408 @@ bytes_to_sectors (off_t size) {
 
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in inode table. */
+	struct list_elem lru_elem;          /* In closed_inodes if unopened. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
+	bool loading;                       /* True while DATA is being read. */
+	bool stale;                         /* Replaced by inode_create(). */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock lock;                 /* Protects the fields below. */
+	struct lock dir_lock;               /* Serializes namespace operations. */
+#ifdef EFILESYS
+	struct lock cluster_lock;           /* Protects the chain cache. */
+	cluster_t *clusters;                /* CLUSTERS[i] is data cluster i. */
+	size_t cluster_cnt;                 /* Chain clusters cached so far. */
+	size_t cluster_cap;                 /* Capacity of CLUSTERS. */
+#endif
+	void *private;                      /* Owner data, see inode_set_private(). */
+	void (*private_destroy) (void *);   /* Frees PRIVATE. */
 	struct inode_disk data;             /* Inode content. */
 };
 
+#ifdef EFILESYS
+/* Fills cluster CLST with zeros. */
+static void
+zero_cluster (cluster_t clst) {
+	static char zeros[DISK_SECTOR_SIZE];
+	disk_sector_t sector = cluster_to_sector (clst);
+	size_t i;
+
+	for (i = 0; i < SECTORS_PER_CLUSTER; i++)
+		buffer_cache_write (sector + i, zeros, 0, DISK_SECTOR_SIZE);
+}
+
+/* Gives DATA, a new inode, a chain of CNT zeroed clusters.  On
+ * failure, releases whatever was allocated and returns false. */
+static bool
+allocate_chain (struct inode_disk *data, size_t cnt) {
+	cluster_t last = 0;
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		cluster_t clst = fat_create_chain (last);
+		if (clst == 0) {
+			if (data->start != 0)
+				fat_remove_chain (data->start, 0);
+			data->start = 0;
+			return false;
+		}
+		if (last == 0)
+			data->start = clst;
+		zero_cluster (clst);
+		last = clst;
+	}
+	return true;
+}
+
+/* Releases the data clusters of the inode DATA. */
+static void
+release_blocks (struct inode_disk *data) {
+	if (data->start != 0)
+		fat_remove_chain (data->start, 0);
+}
+
+/* Returns data cluster IDX of INODE, or 0 if the chain is shorter.
+ * If EXTEND is true, a short chain is first extended with zeroed
+ * clusters; 0 is then returned only if the disk is full.
+ *
+ * The chain is cached in INODE->clusters as far as it has been
+ * walked, so that seeking into a long file does not follow the
+ * chain through fat_get() from its start every time.  Chains only
+ * grow while an inode is open, so the cache never goes stale. */
+static cluster_t
+chain_cluster (struct inode *inode, size_t idx, bool extend) {
+	while (inode->cluster_cnt <= idx) {
+		cluster_t clst;
+
+		if (inode->cluster_cnt == 0) {
+			clst = inode->data.start;
+			if (clst == 0) {
+				if (!extend || (clst = fat_create_chain (0)) == 0)
+					return 0;
+				zero_cluster (clst);
+				inode->data.start = clst;
+				buffer_cache_write (inode->sector, &inode->data, 0,
+						DISK_SECTOR_SIZE);
+			}
+		} else {
+			cluster_t last = inode->clusters[inode->cluster_cnt - 1];
+			clst = fat_get (last);
+			if (clst == EOChain) {
+				if (!extend || (clst = fat_create_chain (last)) == 0)
+					return 0;
+				zero_cluster (clst);
+			}
+		}
+
+		if (inode->cluster_cnt == inode->cluster_cap) {
+			size_t cap = inode->cluster_cap * 2 + 8;
+			cluster_t *clusters = realloc (inode->clusters,
+					cap * sizeof *clusters);
+			if (clusters == NULL)
+				return 0;
+			inode->clusters = clusters;
+			inode->cluster_cap = cap;
+		}
+		inode->clusters[inode->cluster_cnt++] = clst;
+	}
+	return inode->clusters[idx];
+}
+
+/* Returns the disk sector holding data sector IDX of INODE.  If HINT
+ * is non-null, the chain is extended as needed.  Returns 0 if the
+ * sector does not exist or cannot be allocated. */
+static disk_sector_t
+data_sector (struct inode *inode, size_t idx, disk_sector_t *hint) {
+	cluster_t clst;
+
+	lock_acquire (&inode->cluster_lock);
+	clst = chain_cluster (inode, idx / SECTORS_PER_CLUSTER, hint != NULL);
+	lock_release (&inode->cluster_lock);
+	return clst != 0
+		? cluster_to_sector (clst) + idx % SECTORS_PER_CLUSTER : 0;
+}
+
+/* Allocates the initial SECTORS data sectors of the new inode DATA
+ * at SECTOR. */
+static bool
+allocate_initial (struct inode_disk *data, disk_sector_t sector UNUSED,
+		size_t sectors) {
+	return allocate_chain (data, DIV_ROUND_UP (sectors, SECTORS_PER_CLUSTER));
+}
+
+/* Allocates a sector for a new inode and stores it in *SECTORP. */
+bool
+inode_allocate (disk_sector_t *sectorp) {
+	cluster_t clst = fat_create_chain (0);
+	if (clst == 0)
+		return false;
+	*sectorp = cluster_to_sector (clst);
+	return true;
+}
+
+/* Releases SECTOR, allocated by inode_allocate(). */
+void
+inode_release (disk_sector_t sector) {
+	fat_remove_chain (sector_to_cluster (sector), 0);
+}
+#else
+/* Allocates a sector, preferably at *HINT, fills it with zeros and
+ * stores its number in *SECTORP.  Advances *HINT past it, so that
+ * consecutive allocations land next to each other.  Returns false
+ * if the disk is full. */
+static bool
+allocate_zeroed (disk_sector_t *sectorp, disk_sector_t *hint) {
+	static char zeros[DISK_SECTOR_SIZE];
+
+	if (!free_map_allocate_near (1, *hint, sectorp))
+		return false;
+	buffer_cache_write (*sectorp, zeros, 0, DISK_SECTOR_SIZE);
+	*hint = *sectorp + 1;
+	return true;
+}
+
+/* Returns the pointer in SLOT of DATA, the contents of the inode at
+ * INODE_SECTOR.  If it is a hole and HINT is non-null, first fills
+ * it with a freshly allocated sector and writes the inode back.
+ * Returns 0 for a hole. */
+static disk_sector_t
+inode_entry (struct inode_disk *data, disk_sector_t inode_sector,
+		disk_sector_t *slot, disk_sector_t *hint) {
+	if (*slot == 0 && hint != NULL && allocate_zeroed (slot, hint))
+		buffer_cache_write (inode_sector, data, 0, DISK_SECTOR_SIZE);
+	return *slot;
+}
+
+/* Returns pointer IDX of index block BLOCK, allocating it first if
+ * it is a hole and HINT is non-null.  Returns 0 for a hole. */
+static disk_sector_t
+index_entry (disk_sector_t block, size_t idx, disk_sector_t *hint) {
+	disk_sector_t sector;
+	off_t ofs = idx * sizeof sector;
+
+	buffer_cache_read (block, &sector, ofs, sizeof sector);
+	if (sector == 0 && hint != NULL && allocate_zeroed (&sector, hint))
+		buffer_cache_write (block, &sector, ofs, sizeof sector);
+	return sector;
+}
+
+/* Returns the disk sector holding data sector IDX of the inode at
+ * INODE_SECTOR, whose contents are DATA.  If HINT is non-null, holes
+ * on the way are filled, including index blocks, preferably starting
+ * at sector *HINT.  Returns 0 if the sector is a hole, lies beyond
+ * MAX_SECTORS or cannot be allocated.
+ * Index blocks are read through the buffer cache, so a lookup does
+ * at most two cache accesses and no disk reads once they are cached. */
+static disk_sector_t
+index_lookup (struct inode_disk *data, disk_sector_t inode_sector,
+		size_t idx, disk_sector_t *hint) {
+	disk_sector_t block;
+
+	if (idx < DIRECT_CNT)
+		return inode_entry (data, inode_sector, &data->direct[idx], hint);
+	idx -= DIRECT_CNT;
+
+	if (idx < PTRS_PER_SECTOR) {
+		block = inode_entry (data, inode_sector, &data->indirect, hint);
+		return block != 0 ? index_entry (block, idx, hint) : 0;
+	}
+	idx -= PTRS_PER_SECTOR;
+
+	if (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR) {
+		block = inode_entry (data, inode_sector, &data->doubly_indirect,
+				hint);
+		if (block != 0)
+			block = index_entry (block, idx / PTRS_PER_SECTOR, hint);
+		return block != 0
+			? index_entry (block, idx % PTRS_PER_SECTOR, hint) : 0;
+	}
+	return 0;
+}
+
+/* Releases index block BLOCK and everything it points to.  LEVEL is
+ * 1 for a block of data pointers and 2 for a block of index blocks. */
+static void
+release_index (disk_sector_t block, int level) {
+	size_t i;
+
+	for (i = 0; i < PTRS_PER_SECTOR; i++) {
+		disk_sector_t sector = index_entry (block, i, NULL);
+		if (sector == 0)
+			continue;
+		if (level > 1)
+			release_index (sector, level - 1);
+		else
+			free_map_release (sector, 1);
+	}
+	free_map_release (block, 1);
+}
+
+/* Releases every data and index sector of the inode DATA. */
+static void
+release_blocks (struct inode_disk *data) {
+	size_t i;
+
+	for (i = 0; i < DIRECT_CNT; i++)
+		if (data->direct[i] != 0)
+			free_map_release (data->direct[i], 1);
+	if (data->indirect != 0)
+		release_index (data->indirect, 1);
+	if (data->doubly_indirect != 0)
+		release_index (data->doubly_indirect, 2);
+}
+
+/* Returns the disk sector holding data sector IDX of INODE,
+ * allocating it if HINT is non-null.  Returns 0 for a hole or if
+ * allocation fails. */
+static disk_sector_t
+data_sector (struct inode *inode, size_t idx, disk_sector_t *hint) {
+	return index_lookup (&inode->data, inode->sector, idx, hint);
+}
+
+/* Allocates the initial SECTORS data sectors of the new inode DATA
+ * at SECTOR, so that writes within its initial length cannot fail
+ * for lack of space. */
+static bool
+allocate_initial (struct inode_disk *data, disk_sector_t sector,
+		size_t sectors) {
+	disk_sector_t hint = sector + 1;
+	size_t i;
+
+	if (sectors > MAX_SECTORS)
+		return false;
+	for (i = 0; i < sectors; i++)
+		if (index_lookup (data, sector, i, &hint) == 0) {
+			release_blocks (data);
+			return false;
+		}
+	return true;
+}
+
+/* Allocates a sector for a new inode and stores it in *SECTORP. */
+bool
+inode_allocate (disk_sector_t *sectorp) {
+	return free_map_allocate (1, sectorp);
+}
+
+/* Releases SECTOR, allocated by inode_allocate(). */
+void
+inode_release (disk_sector_t sector) {
+	free_map_release (sector, 1);
+}
+#endif /* EFILESYS */
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
- * POS. */
+ * POS, either because POS is past the end or because it lies in a
+ * hole. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos) {
+	disk_sector_t sector;
+
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+	sector = data_sector (inode, pos / DISK_SECTOR_SIZE, NULL);
+	return sector != 0 ? sector : (disk_sector_t) -1;
+}
+
+/* Returns the disk sector holding byte offset POS within INODE,
+ * or -1 if INODE has no data at POS. */
+disk_sector_t
+inode_byte_to_sector (struct inode *inode, off_t pos) {
+	disk_sector_t sector;
+
+	rwlock_acquire_read (&inode->lock);
+	sector = byte_to_sector (inode, pos);
+	rwlock_release_read (&inode->lock);
+	return sector;
+}
+
+/* Number of closed inodes kept in memory. */
+#define CLOSED_INODE_CNT 32
+
+/* Table of inodes in memory, keyed by sector, so that opening a
+ * single inode twice returns the same `struct inode'.  Besides the
+ * open inodes it holds the CLOSED_INODE_CNT most recently closed
+ * ones, most recent first in closed_inodes, so that reopening a hot
+ * file does not read its inode sector again. */
+static struct hash open_inodes;
+static struct list closed_inodes;
+static size_t closed_cnt;
+
+/* Protects the table, the closed list, and each inode's OPEN_CNT
+ * and REMOVED. */
+static struct lock inode_table_lock;
+
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct inode, elem)->sector);
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct inode, elem)->sector
+		< hash_entry (b, struct inode, elem)->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+		PANIC ("inode table creation failed");
+	list_init (&closed_inodes);
+	closed_cnt = 0;
+	lock_init (&inode_table_lock);
+}
+
+/* Frees INODE, which has already been taken out of the table. */
+static void
+inode_free (struct inode *inode) {
+	if (inode->private_destroy != NULL)
+		inode->private_destroy (inode->private);
+#ifdef EFILESYS
+	free (inode->clusters);
+#endif
+	free (inode);
+}
+
+/* Drops the in-memory inode for SECTOR, if any, because a new inode
+ * has just been written there.  Such an inode was read from the
+ * sector while it was free, by an opener that raced with the removal
+ * of its previous file, so its data is not the new inode's.  A closed
+ * one is freed now.  An open one is taken out of the table, so that
+ * later openers read the new inode, and is freed by its last
+ * inode_close(). */
+static void
+inode_forget (disk_sector_t sector) {
+	struct hash_elem *e;
+	struct inode *inode;
+	struct inode key;
+
+	lock_acquire (&inode_table_lock);
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	if (e == NULL) {
+		lock_release (&inode_table_lock);
+		return;
+	}
+	inode = hash_entry (e, struct inode, elem);
+	hash_delete (&open_inodes, &inode->elem);
+	if (inode->open_cnt > 0) {
+		inode->stale = true;
+		lock_release (&inode_table_lock);
+		return;
+	}
+	list_remove (&inode->lru_elem);
+	closed_cnt--;
+	lock_release (&inode_table_lock);
+
+	inode_free (inode);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -81,20 +484,13 @@ inode_create (disk_sector_t sector, off_t length) {
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		if (allocate_initial (disk_inode, sector, bytes_to_sectors (length))) {
+			buffer_cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+			inode_forget (sector);
+			success = true;
+		}
 		free (disk_inode);
 	}
 	return success;
@@ -105,38 +501,78 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+	struct hash_elem *e;
 	struct inode *inode;
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
+	struct inode key;
+
+	/* Check whether this inode is already in memory. */
+	lock_acquire (&inode_table_lock);
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	if (e != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		if (inode->open_cnt == 0) {
+			list_remove (&inode->lru_elem);
+			closed_cnt--;
 		}
+		inode->open_cnt++;
+		if (inode->loading) {
+			/* Another opener is still reading the inode; it holds the
+			 * inode's lock for writing until DATA is valid. */
+			lock_release (&inode_table_lock);
+			rwlock_acquire_read (&inode->lock);
+			rwlock_release_read (&inode->lock);
+		} else
+			lock_release (&inode_table_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&inode_table_lock);
 		return NULL;
+	}
 
-	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	/* Initialize.  The inode goes into the table before it is read,
+	 * so that the table lock is not held across the disk read.  It
+	 * is marked as loading and write-locked meanwhile, so anyone who
+	 * finds it waits until it is complete. */
 	inode->sector = sector;
+	hash_insert (&open_inodes, &inode->elem);
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	inode->loading = true;
+	inode->stale = false;
+	rwlock_init (&inode->lock);
+	rwlock_acquire_write (&inode->lock);
+	lock_init (&inode->dir_lock);
+#ifdef EFILESYS
+	lock_init (&inode->cluster_lock);
+#endif
+	inode->private = NULL;
+	inode->private_destroy = NULL;
+#ifdef EFILESYS
+	inode->clusters = NULL;
+	inode->cluster_cnt = inode->cluster_cap = 0;
+#endif
+	lock_release (&inode_table_lock);
+
+	buffer_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	inode->loading = false;
+	rwlock_release_write (&inode->lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&inode_table_lock);
 		inode->open_cnt++;
+		lock_release (&inode_table_lock);
+	}
 	return inode;
 }
 
@@ -146,9 +582,58 @@ inode_get_inumber (const struct inode *inode) {
 	return inode->sector;
 }
 
+/* Returns true if a new inode has been created in INODE's sector
+ * since INODE was opened, so that INODE no longer describes it. */
+bool
+inode_is_stale (struct inode *inode) {
+	bool stale;
+
+	lock_acquire (&inode_table_lock);
+	stale = inode->stale;
+	lock_release (&inode_table_lock);
+	return stale;
+}
+
+/* Locks directory INODE against concurrent lookups, additions and
+ * removals of names.  This is separate from the lock on INODE's
+ * data, which the directory layer takes again to read and write its
+ * entries. */
+void
+inode_lock_dir (struct inode *inode) {
+	lock_acquire (&inode->dir_lock);
+}
+
+/* Unlocks directory INODE, locked by inode_lock_dir(). */
+void
+inode_unlock_dir (struct inode *inode) {
+	lock_release (&inode->dir_lock);
+}
+
+/* Returns the data attached to INODE with inode_set_private(), or
+ * a null pointer. */
+void *
+inode_get_private (struct inode *inode) {
+	return inode->private;
+}
+
+/* Attaches PRIVATE to INODE for as long as INODE stays in memory,
+ * replacing and destroying any earlier data.  DESTROY, if non-null,
+ * is called on PRIVATE when the last opener closes INODE.  This lets
+ * a layer above keep per-file state, such as a directory's name
+ * index, that is shared by everyone who has the file open. */
+void
+inode_set_private (struct inode *inode, void *private,
+		void (*destroy) (void *)) {
+	if (inode->private_destroy != NULL && inode->private != private)
+		inode->private_destroy (inode->private);
+	inode->private = private;
+	inode->private_destroy = destroy;
+}
+
 /* Closes INODE and writes it to disk.
- * If this was the last reference to INODE, frees its memory.
- * If INODE was also a removed inode, frees its blocks. */
+ * If this was the last reference to INODE, keeps it among the
+ * recently closed inodes, evicting the oldest of them; if INODE was
+ * also a removed inode, frees its blocks and its memory instead. */
 void
 inode_close (struct inode *inode) {
 	/* Ignore null pointer. */
@@ -156,19 +641,44 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
+	lock_acquire (&inode_table_lock);
 	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+		/* Don't keep an inode that inode_forget() already took out of
+		 * the table, or one read from a sector that holds no inode. */
+		if (inode->stale || inode->data.magic != INODE_MAGIC) {
+			if (!inode->stale)
+				hash_delete (&open_inodes, &inode->elem);
+			lock_release (&inode_table_lock);
+
+			inode_free (inode);
+			return;
+		}
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			hash_delete (&open_inodes, &inode->elem);
+			lock_release (&inode_table_lock);
+
+			release_blocks (&inode->data);
+			inode_release (inode->sector);
+			inode_free (inode);
+			return;
 		}
 
-		free (inode); 
+		/* Keep it around in case it is opened again soon. */
+		list_push_front (&closed_inodes, &inode->lru_elem);
+		if (++closed_cnt > CLOSED_INODE_CNT) {
+			struct inode *victim = list_entry (list_pop_back (&closed_inodes),
+					struct inode, lru_elem);
+			closed_cnt--;
+			hash_delete (&open_inodes, &victim->elem);
+			lock_release (&inode_table_lock);
+
+			inode_free (victim);
+			return;
+		}
 	}
+	lock_release (&inode_table_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -176,7 +686,9 @@ inode_close (struct inode *inode) {
 void
 inode_remove (struct inode *inode) {
 	ASSERT (inode != NULL);
+	lock_acquire (&inode_table_lock);
 	inode->removed = true;
+	lock_release (&inode_table_lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -186,8 +698,10 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
+	/* Readers share the lock: nothing below changes the inode except
+	 * the FAT chain cache, which has a lock of its own. */
+	rwlock_acquire_read (&inode->lock);
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -203,90 +717,74 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		if (sector_idx == (disk_sector_t) -1)
+			memset (buffer + bytes_read, 0, chunk_size);
+		else
+			buffer_cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+					chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+	rwlock_release_read (&inode->lock);
 
 	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or the inode reaches its
+ * maximum size.  Writing past end of file extends the inode; any
+ * gap between the old end and OFFSET is left as a hole. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
+	disk_sector_t hint;
 
-	if (inode->deny_write_cnt)
+	rwlock_acquire_write (&inode->lock);
+	if (inode->deny_write_cnt) {
+		rwlock_release_write (&inode->lock);
 		return 0;
+	}
+
+	/* New sectors go right after the one holding the previous byte,
+	 * if that is free; -1 + 1 leaves no hint. */
+	hint = offset > 0 ? byte_to_sector (inode, offset - 1) + 1
+		: inode->sector + 1;
 
 	while (size > 0) {
-		/* Sector to write, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		/* Sector to write, starting byte offset within sector.
+		 * Holes are filled as they are written. */
+		disk_sector_t sector_idx = data_sector (inode, offset / DISK_SECTOR_SIZE,
+				&hint);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
-		/* Bytes left in inode, bytes left in sector, lesser of the two. */
-		off_t inode_left = inode_length (inode) - offset;
+		/* Bytes left in sector. */
 		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-		int min_left = inode_left < sector_left ? inode_left : sector_left;
 
 		/* Number of bytes to actually write into this sector. */
-		int chunk_size = size < min_left ? size : min_left;
-		if (chunk_size <= 0)
+		int chunk_size = size < sector_left ? size : sector_left;
+		if (sector_idx == 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		buffer_cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
+	if (bytes_written > 0 && offset > inode->data.length) {
+		inode->data.length = offset;
+		buffer_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	}
+	rwlock_release_write (&inode->lock);
 	return bytes_written;
 }
 
@@ -295,8 +793,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	void
 inode_deny_write (struct inode *inode) 
 {
+	rwlock_acquire_write (&inode->lock);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	rwlock_release_write (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -304,9 +804,11 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	rwlock_acquire_write (&inode->lock);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	rwlock_release_write (&inode->lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -1,6 +1,25 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
 #include "vm/vm.h"
+#include <debug.h>
+#include "filesys/buffer_cache.h"
+#include "filesys/inode.h"
+#include "filesys/page_cache.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Read-ahead window, in sectors. */
+#define RA_MIN_WINDOW 4
+#define RA_MAX_WINDOW 32
+
+/* Sectors waiting to be prefetched by page_cache_kworkerd. */
+#define RA_QUEUE_SIZE 64
+static disk_sector_t ra_queue[RA_QUEUE_SIZE];
+static size_t ra_head, ra_tail;         /* Consumer and producer counts. */
+static struct lock ra_lock;             /* Protects the queue. */
+static struct semaphore ra_pending;     /* Number of queued sectors. */
+
+static void page_cache_kworkerd (void *aux);
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
@@ -15,10 +34,74 @@ static const struct page_operations page_cache_op = {
 
 tid_t page_cache_workerd;
 
-/* The initializer of file vm */
+/* The initializer of file vm.  Starts the read-ahead daemon; later
+ * calls do nothing. */
 void
 pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+	if (page_cache_workerd != 0)
+		return;
+
+	lock_init (&ra_lock);
+	sema_init (&ra_pending, 0);
+	ra_head = ra_tail = 0;
+	page_cache_workerd = thread_create ("kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+	if (page_cache_workerd == TID_ERROR)
+		PANIC ("could not start the read-ahead daemon");
+}
+
+/* Queues SECTOR for read-ahead.  Requests are hints, so they are
+ * dropped when the queue is full. */
+static void
+readahead_enqueue (disk_sector_t sector) {
+	bool queued = false;
+
+	lock_acquire (&ra_lock);
+	if (ra_tail - ra_head < RA_QUEUE_SIZE) {
+		ra_queue[ra_tail++ % RA_QUEUE_SIZE] = sector;
+		queued = true;
+	}
+	lock_release (&ra_lock);
+
+	if (queued)
+		sema_up (&ra_pending);
+}
+
+/* Records that SIZE bytes were just read at POS from INODE through a
+ * file whose history is RA.  When the read continues where the last
+ * one stopped, the read-ahead window grows and the sectors beyond
+ * the read are queued for the daemon; any other access resets it. */
+void
+page_cache_access (struct readahead *ra, struct inode *inode,
+		off_t pos, off_t size) {
+	off_t start, end;
+
+	if (page_cache_workerd == 0 || size <= 0)
+		return;
+
+	if (pos != ra->next_pos) {
+		ra->window = 0;
+		ra->end_pos = 0;
+		ra->next_pos = pos + size;
+		return;
+	}
+	ra->next_pos = pos + size;
+	if (ra->window == 0)
+		ra->window = RA_MIN_WINDOW;
+	else if (ra->window < RA_MAX_WINDOW)
+		ra->window *= 2;
+
+	/* Skip whatever earlier calls have already asked for. */
+	start = ra->next_pos > ra->end_pos ? ra->next_pos : ra->end_pos;
+	start = start / DISK_SECTOR_SIZE * DISK_SECTOR_SIZE;
+	end = ra->next_pos + (off_t) ra->window * DISK_SECTOR_SIZE;
+	for (; start < end; start += DISK_SECTOR_SIZE) {
+		disk_sector_t sector = inode_byte_to_sector (inode, start);
+		if (sector == (disk_sector_t) -1)
+			break;
+		readahead_enqueue (sector);
+	}
+	ra->end_pos = start;
 }
 
 /* Initialize the page cache */
@@ -44,7 +127,18 @@ static void
 page_cache_destroy (struct page *page) {
 }
 
-/* Worker thread for page cache */
+/* Worker thread for page cache.  Pulls queued sectors and reads
+ * them into the buffer cache while their readers compute. */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		disk_sector_t sector;
+
+		sema_down (&ra_pending);
+		lock_acquire (&ra_lock);
+		sector = ra_queue[ra_head++ % RA_QUEUE_SIZE];
+		lock_release (&ra_lock);
+
+		buffer_cache_prefetch (sector);
+	}
 }
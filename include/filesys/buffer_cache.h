@@ -0,0 +1,27 @@
+#ifndef FILESYS_BUFFER_CACHE_H
+#define FILESYS_BUFFER_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/disk.h"
+
+/* Number of sectors held by the buffer cache. */
+#define BUFFER_CACHE_SIZE 64
+
+/* Write-behind defaults: dirty sectors are written back once they
+ * are this many timer ticks old, or as soon as this percentage of
+ * the cache is dirty. */
+#define BUFFER_CACHE_DIRTY_AGE 300
+#define BUFFER_CACHE_DIRTY_RATIO 50
+
+extern int64_t buffer_cache_dirty_age;
+extern int buffer_cache_dirty_ratio;
+
+void buffer_cache_init (void);
+void buffer_cache_read (disk_sector_t, void *, int sector_ofs, int size);
+void buffer_cache_write (disk_sector_t, const void *, int sector_ofs, int size);
+void buffer_cache_prefetch (disk_sector_t);
+void buffer_cache_flush (void);
+void buffer_cache_print_stats (void);
+
+#endif /* filesys/buffer_cache.h */
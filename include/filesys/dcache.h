@@ -0,0 +1,23 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+struct inode;
+
+/* Number of names held by the directory entry cache. */
+#define DCACHE_SIZE 128
+
+/* Sector recorded for a name known not to exist. */
+#define DCACHE_NO_ENTRY ((disk_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (disk_sector_t parent, const char *name,
+		struct inode **);
+void dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector);
+void dcache_invalidate (disk_sector_t parent, const char *name);
+void dcache_print_stats (void);
+
+#endif /* filesys/dcache.h */
@@ -8,10 +8,17 @@
 struct bitmap;
 
 void inode_init (void);
+bool inode_allocate (disk_sector_t *);
+void inode_release (disk_sector_t);
 bool inode_create (disk_sector_t, off_t);
 struct inode *inode_open (disk_sector_t);
 struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
+bool inode_is_stale (struct inode *);
+void inode_lock_dir (struct inode *);
+void inode_unlock_dir (struct inode *);
+void *inode_get_private (struct inode *);
+void inode_set_private (struct inode *, void *, void (*destroy) (void *));
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
@@ -19,5 +26,6 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+disk_sector_t inode_byte_to_sector (struct inode *, off_t);
 
 #endif /* filesys/inode.h */
@@ -1,12 +1,24 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <stdbool.h>
+#include "filesys/off_t.h"
 
 struct page;
+struct inode;
 enum vm_type;
 
 struct page_cache {};
 
-void page_cache_init (void);
+/* Sequential access detector kept in each open file.
+ * All-zero is a valid initial state. */
+struct readahead {
+	off_t next_pos;             /* Where a sequential reader reads next. */
+	off_t end_pos;              /* End of the range already requested. */
+	int window;                 /* Sectors to read ahead, 0 if random. */
+};
+
+void pagecache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+void page_cache_access (struct readahead *, struct inode *,
+		off_t pos, off_t size);
 #endif
@@ -0,0 +1,76 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* 17.14 fixed-point numbers, used by the MLFQS scheduler.  The
+ * kernel does not use floating point, so fractional values such as
+ * load_avg and recent_cpu are stored as integers scaled by FP_F. */
+/* MLFQS 스케줄러가 쓰는 17.14 고정소수점 수입니다. 커널은 부동소수점을
+ * 쓰지 않으므로 load_avg, recent_cpu 같은 분수 값은 FP_F 배 한 정수로
+ * 저장합니다. */
+typedef int fixed_t;
+
+#define FP_F (1 << 14)                  /* 1.0 in 17.14 format. */
+
+/* Converts integer N to fixed point. */
+static inline fixed_t
+fp_from_int (int n) {
+	return n * FP_F;
+}
+
+/* Converts X to an integer, rounding toward zero. */
+static inline int
+fp_to_int (fixed_t x) {
+	return x / FP_F;
+}
+
+/* Converts X to an integer, rounding to nearest. */
+static inline int
+fp_round (fixed_t x) {
+	return x >= 0 ? (x + FP_F / 2) / FP_F : (x - FP_F / 2) / FP_F;
+}
+
+static inline fixed_t
+fp_add (fixed_t x, fixed_t y) {
+	return x + y;
+}
+
+static inline fixed_t
+fp_sub (fixed_t x, fixed_t y) {
+	return x - y;
+}
+
+static inline fixed_t
+fp_add_int (fixed_t x, int n) {
+	return x + n * FP_F;
+}
+
+static inline fixed_t
+fp_sub_int (fixed_t x, int n) {
+	return x - n * FP_F;
+}
+
+/* The product and quotient of two fixed-point numbers need the
+ * extra bits of a 64-bit intermediate. */
+static inline fixed_t
+fp_mul (fixed_t x, fixed_t y) {
+	return (int64_t) x * y / FP_F;
+}
+
+static inline fixed_t
+fp_mul_int (fixed_t x, int n) {
+	return x * n;
+}
+
+static inline fixed_t
+fp_div (fixed_t x, fixed_t y) {
+	return (int64_t) x * FP_F / y;
+}
+
+static inline fixed_t
+fp_div_int (fixed_t x, int n) {
+	return x / n;
+}
+
+#endif /* threads/fixed_point.h */
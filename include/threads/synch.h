@@ -28,6 +28,27 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Reader-writer lock.  Any number of readers may hold it at once,
+   or a single writer.  Writers hold LOCK for as long as they own
+   the rwlock, so they receive priority donation from every thread
+   that blocks behind them.  A waiting writer also keeps new
+   readers out, so a steady stream of readers cannot starve it. */
+struct rwlock {
+	struct lock lock;           /* Held by the writer. */
+	unsigned readers;           /* Number of active readers. */
+	bool writer_waiting;        /* Writer waits for READERS to drain. */
+	struct semaphore drained;   /* Upped by the last reader out. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
 /* Condition variable. */
 struct condition {
 	struct list waiters;        /* List of waiting threads. */
@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed_point.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #ifdef VM
@@ -29,6 +30,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, used by the MLFQS scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -135,12 +141,18 @@ struct thread {
 	struct semaphore fork_sema;			/* project 2 fork 에서 사용할 세마포어 */
 	struct semaphore clear_sema;		/* project 2 자식 들의 syn를 위해 */
 
+	int nice;							/* mlfqs: 다른 스레드에게 양보하는 정도 */
+	fixed_t recent_cpu;					/* mlfqs: 최근에 사용한 CPU 시간 */
+	bool cpu_dirty;						/* mlfqs: cpu_list 에 들어 있는지 */
+
 	struct list donations;				/* 자신에게 기부한 스레드를 담을 리스트*/
 	struct list children;				/* project 2 자식 리스트*/
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
 	struct list_elem d_elem;			/* donations 리스트에 쓰일 원소 */
 	struct list_elem child_elem;		/* project 2 리스트에 쓰일 원소 */
+	struct list_elem all_elem;			/* all_list 에 쓰일 원소 */
+	struct list_elem cpu_elem;			/* mlfqs: cpu_list 에 쓰일 원소 */
 	
 	struct file *running_file;			/* project 2 현재 실행 중인 파일을 담을 변수*/
 	struct file **fdt;					/* project 2 파일 디스크립터 설정 */
@@ -173,9 +185,8 @@ extern bool thread_mlfqs;
 
 void thread_sleep(int64_t);
 void thread_wakeup(int64_t);
-bool thread_compare_time(const struct list_elem *a,
-							 const struct list_elem *b,
-							 void *aux);
+int64_t thread_next_wakeup(void);
+int thread_wakeup_max_work(void);
 
 /*-----------------------------------------------------------------------*/
 
@@ -185,6 +196,7 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_idle_ticks (int64_t);
 void thread_print_stats (void);
 
 
@@ -5,6 +5,4 @@
 
 void syscall_init (void);
 
-struct lock filesys_lock;
-
 #endif /* userprog/syscall.h */
\ No newline at end of file
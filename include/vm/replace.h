@@ -0,0 +1,34 @@
+#ifndef VM_REPLACE_H
+#define VM_REPLACE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lib/kernel/list.h"
+
+struct frame;
+
+/* LRU-K 에서 기억하는 최근 참조 시각의 개수. */
+#define LRU_K 2
+
+/* WSClock 의 작업 집합 창. 이보다 오래 참조되지 않은 프레임은
+ * 작업 집합 밖에 있는 것으로 본다. (틱 단위) */
+#define WSCLOCK_TAU 50
+
+/* 페이지 교체 정책.
+ * page_operations 처럼 함수 테이블로 정책을 갈아 끼운다.
+ * 모든 함수는 frame_lock 을 잡은 상태에서 불린다. */
+struct replace_policy {
+	const char *name;
+	/* 내보낼 프레임을 고른다. 고를 수 있는 프레임이 없으면 NULL. */
+	struct frame *(*select) (void);
+	/* FRAME 이 프레임 테이블에서 빠지기 직전에 불린다. */
+	void (*remove) (struct frame *frame);
+};
+
+extern const struct replace_policy *replace_policy;
+
+bool replace_set_policy (const char *name);
+void replace_init (struct list *frames, size_t *cnt);
+void replace_touch (struct frame *frame, int64_t now);
+
+#endif
@@ -5,6 +5,7 @@
 #include "include/lib/kernel/hash.h"
 #include "include/lib/string.h"
 #include "threads/synch.h"
+#include "devices/disk.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -33,6 +34,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/replace.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -59,6 +61,8 @@ struct page {
 	struct hash_elem elem; /* spt 에서 사용할 원소 */
 
 	bool writable; /* 쓰기를 할 수 있는지 확인하는 변수 */
+	struct thread *owner; /* 페이지를 가진 스레드 (pml4 를 찾을 때 사용) */
+	struct list_elem share_elem; /* 프레임을 공유하는 페이지 리스트에 넣을 변수 */
 	int mapped_page_count; /* 파일 유형일때 연속된 페이지를 확인하는 변수 */
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -78,8 +82,20 @@ struct page {
 struct frame {
 	void *kva;					/*kernel virtual address*/
 	struct page *page;
+	struct thread *owner;		/* page 를 가진 스레드, 이 pml4 로 접근 비트를 본다 */
+	bool pinned;				/* 내보내는 중이라 clock 이 건너뛰어야 하는 프레임 */
+	int64_t ref_hist[LRU_K];	/* 최근 참조 시각, [0] 이 가장 최근 (교체 정책용) */
 
 	struct list_elem elem;		/* 프레임 리스트에 넣을 변수 */
+	struct list sharers;		/* 이 프레임을 매핑한 페이지들 (copy-on-write) */
+	int share_cnt;				/* sharers 의 원소 개수 */
+
+	/* 읽기 전용 실행 파일 페이지를 담은 프레임이면 공유 테이블에 등록된다. */
+	bool shared;				/* 공유 테이블에 들어 있는지 */
+	disk_sector_t inumber;		/* 실행 파일 inode 의 섹터 번호 */
+	off_t offset;				/* 파일 안에서 페이지의 오프셋 */
+	size_t read_bytes;			/* 파일에서 읽은 바이트 수, 나머지는 0 */
+	struct hash_elem shared_elem;	/* 공유 테이블에 넣을 변수 */
 };
 
 /* The function table for page operations.
@@ -118,7 +134,7 @@ struct page_operations {
 */
 struct supplemental_page_table {
 	struct hash pages; /* 페이지들을 관리 하기위한 해쉬 자료구조 */
-	struct lock page_lock;
+	struct rwlock page_lock; /* 조회는 공유, 삽입은 배타적으로 잡는다 */
 };
 
 #include "threads/thread.h"
@@ -144,5 +160,9 @@ bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
 void vm_free_frame(struct frame *frame);
+void vm_print_stats (void);
+bool vm_frame_unshare(struct page *page);
+struct frame *vm_frame_pin(struct page *page);
+void vm_frame_unpin(struct frame *frame);
 
 #endif  /* VM_VM_H */
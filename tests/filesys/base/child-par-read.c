@@ -0,0 +1,135 @@
+/* Child process for par-read test.
+   Child 0 reads the big test file with a single read() and checks
+   that its siblings made progress meanwhile.  The other children
+   read their own test files a byte at a time, over and over, and
+   report their progress until child 0 is done. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/par-read.h"
+
+const char *test_name = "child-par-read";
+
+/* Upper bounds, so that a broken kernel fails instead of hanging. */
+#define START_WAIT_CNT 100000
+#define PASS_CNT 64
+
+static char buf[BUF_SIZE];
+static char big[BIG_SIZE];
+static char expected[BIG_SIZE];
+
+static void
+read_progress (int fd, int progress[CHILD_CNT]) 
+{
+  seek (fd, 0);
+  CHECK (read (fd, progress, CHILD_CNT * sizeof (int))
+         == CHILD_CNT * sizeof (int), "read \"%s\"", PROGRESS_FILE);
+}
+
+static void
+write_progress (int fd, int child_idx, int value) 
+{
+  seek (fd, child_idx * sizeof (int));
+  CHECK (write (fd, &value, sizeof value) == sizeof value,
+         "write \"%s\"", PROGRESS_FILE);
+}
+
+/* Waits for the siblings to start, then reads BIG_FILE in one
+   read() call and checks that some sibling made progress while
+   the call was running. */
+static void
+slow_reader (int progress_fd) 
+{
+  int before[CHILD_CNT], after[CHILD_CNT];
+  bool started = false;
+  bool overlapped = false;
+  int fd;
+  int i, j;
+
+  for (i = 0; i < START_WAIT_CNT && !started; i++) 
+    {
+      read_progress (progress_fd, before);
+      started = true;
+      for (j = 1; j < CHILD_CNT; j++)
+        if (before[j] == 0)
+          started = false;
+    }
+  CHECK (started, "siblings started reading");
+
+  CHECK ((fd = open (BIG_FILE)) > 1, "open \"%s\"", BIG_FILE);
+  read_progress (progress_fd, before);
+  CHECK (read (fd, big, sizeof big) == sizeof big, "read \"%s\"", BIG_FILE);
+  read_progress (progress_fd, after);
+  close (fd);
+  write_progress (progress_fd, 0, PROGRESS_DONE);
+
+  for (j = 1; j < CHILD_CNT; j++)
+    if (after[j] > before[j])
+      overlapped = true;
+  CHECK (overlapped, "siblings made progress during read of \"%s\"",
+         BIG_FILE);
+
+  random_init (CHILD_CNT);
+  random_bytes (expected, sizeof expected);
+  compare_bytes (big, expected, sizeof big, 0, BIG_FILE);
+}
+
+/* Reads this child's test file a byte at a time until child 0
+   reports that it is done, recording progress after each byte. */
+static void
+fast_reader (int progress_fd, int child_idx) 
+{
+  char file_name[16];
+  int progress[CHILD_CNT];
+  int done = 0;
+  int pass;
+  int fd;
+  size_t i;
+
+  snprintf (file_name, sizeof file_name, "par%d", child_idx);
+  random_init (child_idx);
+  random_bytes (buf, sizeof buf);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (pass = 0; pass < PASS_CNT; pass++) 
+    {
+      seek (fd, 0);
+      for (i = 0; i < sizeof buf; i++) 
+        {
+          char c;
+          CHECK (read (fd, &c, 1) > 0, "read \"%s\"", file_name);
+          compare_bytes (&c, buf + i, 1, i, file_name);
+          write_progress (progress_fd, child_idx, ++done);
+        }
+      read_progress (progress_fd, progress);
+      if (progress[0] == PROGRESS_DONE)
+        break;
+    }
+  close (fd);
+}
+
+int
+main (int argc, const char *argv[]) 
+{
+  int child_idx;
+  int progress_fd;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  CHECK ((progress_fd = open (PROGRESS_FILE)) > 1,
+         "open \"%s\"", PROGRESS_FILE);
+  if (child_idx == 0)
+    slow_reader (progress_fd);
+  else
+    fast_reader (progress_fd, child_idx);
+  close (progress_fd);
+
+  return child_idx;
+}
@@ -0,0 +1,52 @@
+/* Spawns 4 child processes, each of which reads a different file.
+   Child 0 reads a file larger than the buffer cache with a single
+   read() call, while the others read their files a byte at a time
+   and report their progress.  The test fails unless the others
+   make progress while child 0 is inside its read, that is, unless
+   readers of different files do not wait for one another. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/par-read.h"
+
+static char buf[BUF_SIZE];
+static char big[BIG_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int fd;
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++) 
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "par%d", i);
+      CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      random_init (i);
+      random_bytes (buf, sizeof buf);
+      CHECK (write (fd, buf, sizeof buf) > 0, "write \"%s\"", file_name);
+      msg ("close \"%s\"", file_name);
+      close (fd);
+    }
+
+  CHECK (create (BIG_FILE, sizeof big), "create \"%s\"", BIG_FILE);
+  CHECK ((fd = open (BIG_FILE)) > 1, "open \"%s\"", BIG_FILE);
+  random_init (CHILD_CNT);
+  random_bytes (big, sizeof big);
+  CHECK (write (fd, big, sizeof big) == sizeof big, "write \"%s\"", BIG_FILE);
+  msg ("close \"%s\"", BIG_FILE);
+  close (fd);
+
+  CHECK (create (PROGRESS_FILE, CHILD_CNT * sizeof (int)),
+         "create \"%s\"", PROGRESS_FILE);
+
+  exec_children ("child-par-read", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
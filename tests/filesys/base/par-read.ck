@@ -0,0 +1,38 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(par-read) begin
+(par-read) create "par0"
+(par-read) open "par0"
+(par-read) write "par0"
+(par-read) close "par0"
+(par-read) create "par1"
+(par-read) open "par1"
+(par-read) write "par1"
+(par-read) close "par1"
+(par-read) create "par2"
+(par-read) open "par2"
+(par-read) write "par2"
+(par-read) close "par2"
+(par-read) create "par3"
+(par-read) open "par3"
+(par-read) write "par3"
+(par-read) close "par3"
+(par-read) create "par-big"
+(par-read) open "par-big"
+(par-read) write "par-big"
+(par-read) close "par-big"
+(par-read) create "par-progress"
+(par-read) exec child 1 of 4: "child-par-read 0"
+(par-read) exec child 2 of 4: "child-par-read 1"
+(par-read) exec child 3 of 4: "child-par-read 2"
+(par-read) exec child 4 of 4: "child-par-read 3"
+(par-read) wait for child 1 of 4 returned 0 (expected 0)
+(par-read) wait for child 2 of 4 returned 1 (expected 1)
+(par-read) wait for child 3 of 4 returned 2 (expected 2)
+(par-read) wait for child 4 of 4 returned 3 (expected 3)
+(par-read) end
+EOF
+pass;
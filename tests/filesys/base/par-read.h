@@ -0,0 +1,19 @@
+#ifndef TESTS_FILESYS_BASE_PAR_READ_H
+#define TESTS_FILESYS_BASE_PAR_READ_H
+
+#define BUF_SIZE 2048
+#define CHILD_CNT 4
+
+/* Child 0 reads this file with a single read() while its siblings
+   keep reading their own files.  It is larger than the buffer
+   cache, so the read has to wait for the disk. */
+#define BIG_FILE "par-big"
+#define BIG_SIZE (64 * 1024)
+
+/* Each child keeps a count of the bytes it has read in its own
+   int-sized slot of this file.  Child 0 stores PROGRESS_DONE in
+   its slot once its read is over. */
+#define PROGRESS_FILE "par-progress"
+#define PROGRESS_DONE (-1)
+
+#endif /* tests/filesys/base/par-read.h */
@@ -0,0 +1,151 @@
+/* Puts many threads to sleep at once, each until its own random
+   deadline, and checks that every thread wakes up exactly on its
+   deadline and that the threads wake up in deadline order.  The
+   deadlines are spread over more than one revolution of the first
+   level of the timer wheel, so sleepers are also moved down from
+   the upper levels while others are waking up.
+
+   It also checks that the work thread_wakeup() does with interrupts
+   off stays bounded: on any one tick it may only wake the threads due
+   on that tick and, when the first level wraps around, move down the
+   threads due in the next WHEEL_WINDOW ticks.  It must not touch the
+   other sleepers. */
+
+#include <stdio.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 200
+#define MAX_DELAY 500
+
+/* Ticks covered by one slot on the second level of the timer
+   wheel, which are aligned to a multiple of this. */
+#define WHEEL_WINDOW 64
+
+/* Information about an individual sleeper. */
+struct sleeper
+  {
+    int id;                     /* Sleeper ID. */
+    int64_t deadline;           /* Tick to wake up at. */
+    int64_t woke;               /* Tick it woke up at. */
+  };
+
+/* Shared between all sleepers. */
+static struct sleeper *sleepers;
+static int *wake_order;
+static int wake_cnt;
+static struct semaphore done;
+
+static thread_func sleeper_func;
+static int max_due (int64_t width);
+
+void
+test_alarm_many (void) 
+{
+  int64_t start;
+  int late = 0;
+  int bound;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sleepers = malloc (sizeof *sleepers * THREAD_CNT);
+  wake_order = malloc (sizeof *wake_order * THREAD_CNT);
+  if (sleepers == NULL || wake_order == NULL)
+    PANIC ("couldn't allocate memory for test");
+  sema_init (&done, 0);
+  wake_cnt = 0;
+
+  msg ("Creating %d threads to sleep until random deadlines.", THREAD_CNT);
+
+  /* Leave enough time to create every thread before the first
+     deadline. */
+  random_init (0);
+  start = timer_ticks () + 100;
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct sleeper *s = &sleepers[i];
+      char name[16];
+
+      s->id = i;
+      s->deadline = start + 1 + random_ulong () % MAX_DELAY;
+      s->woke = -1;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT + 1, sleeper_func, s) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+  if (timer_ticks () >= start)
+    fail ("creating the threads took too long");
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct sleeper *s = &sleepers[wake_order[i]];
+
+      if (s->woke < s->deadline)
+        fail ("thread %d woke up at %lld, before its deadline %lld",
+              s->id, s->woke, s->deadline);
+      if (s->woke != s->deadline)
+        late++;
+      if (i > 0 && s->deadline < sleepers[wake_order[i - 1]].deadline)
+        fail ("thread %d woke up out of order", s->id);
+    }
+  if (late > 0)
+    fail ("%d threads woke up after their deadlines", late);
+
+  bound = max_due (1) + max_due (WHEEL_WINDOW);
+  if (thread_wakeup_max_work () > bound)
+    fail ("a tick moved %d sleepers with interrupts off, "
+          "but at most %d were due soon", thread_wakeup_max_work (), bound);
+  msg ("All %d threads woke up on time, in deadline order.", THREAD_CNT);
+
+  free (wake_order);
+  free (sleepers);
+}
+
+/* Returns the largest number of sleepers whose deadlines fall into
+   a single WIDTH-aligned window of ticks. */
+static int
+max_due (int64_t width) 
+{
+  int max = 0;
+  int i, j;
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      int64_t window = sleepers[i].deadline / width;
+      int cnt = 0;
+
+      for (j = 0; j < THREAD_CNT; j++)
+        if (sleepers[j].deadline / width == window)
+          cnt++;
+      if (cnt > max)
+        max = cnt;
+    }
+  return max;
+}
+
+static void
+sleeper_func (void *s_) 
+{
+  struct sleeper *s = s_;
+  enum intr_level old_level;
+
+  timer_sleep (s->deadline - timer_ticks ());
+
+  old_level = intr_disable ();
+  s->woke = timer_ticks ();
+  wake_order[wake_cnt++] = s->id;
+  intr_set_level (old_level);
+
+  sema_up (&done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-many) begin
+(alarm-many) Creating 200 threads to sleep until random deadlines.
+(alarm-many) All 200 threads woke up on time, in deadline order.
+(alarm-many) end
+EOF
+pass;
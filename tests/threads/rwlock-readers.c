@@ -0,0 +1,82 @@
+/* Starts several reader threads that each take a reader-writer
+   lock for reading and then sleep while holding it.  All of them
+   must be inside at the same time, and a writer must be kept out
+   until the last of them has left. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 5
+
+struct reader_test
+  {
+    struct rwlock rwlock;       /* Lock under test. */
+    struct semaphore done;      /* Upped by each reader as it exits. */
+    int inside;                 /* Readers currently holding RWLOCK. */
+    int max_inside;             /* Largest value INSIDE reached. */
+  };
+
+static thread_func reader_thread_func;
+
+void
+test_rwlock_readers (void) 
+{
+  struct reader_test test;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&test.rwlock);
+  sema_init (&test.done, 0);
+  test.inside = test.max_inside = 0;
+
+  for (i = 0; i < READER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT, reader_thread_func, &test);
+    }
+
+  /* Let every reader get in and go to sleep. */
+  timer_sleep (10);
+  if (rwlock_try_acquire_write (&test.rwlock))
+    fail ("writer got the lock while readers held it");
+  msg ("writer locked out while readers hold the lock");
+
+  for (i = 0; i < READER_CNT; i++)
+    sema_down (&test.done);
+  msg ("%d of %d readers held the lock at once",
+       test.max_inside, READER_CNT);
+
+  if (!rwlock_try_acquire_write (&test.rwlock))
+    fail ("writer could not get the lock after readers left");
+  msg ("writer got the lock after readers left");
+  rwlock_release_write (&test.rwlock);
+}
+
+static void
+reader_thread_func (void *test_) 
+{
+  struct reader_test *test = test_;
+  enum intr_level old_level;
+
+  rwlock_acquire_read (&test->rwlock);
+  old_level = intr_disable ();
+  if (++test->inside > test->max_inside)
+    test->max_inside = test->inside;
+  intr_set_level (old_level);
+
+  timer_sleep (50);
+
+  old_level = intr_disable ();
+  test->inside--;
+  intr_set_level (old_level);
+  rwlock_release_read (&test->rwlock);
+  sema_up (&test->done);
+}
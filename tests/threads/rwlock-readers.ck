@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) writer locked out while readers hold the lock
+(rwlock-readers) 5 of 5 readers held the lock at once
+(rwlock-readers) writer got the lock after readers left
+(rwlock-readers) end
+EOF
+pass;
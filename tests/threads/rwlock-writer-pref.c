@@ -0,0 +1,61 @@
+/* The main thread holds a reader-writer lock for reading.  A
+   writer then blocks waiting for it, and after that a
+   higher-priority reader arrives.  The late reader must queue
+   behind the waiting writer rather than join the main thread, and
+   while it waits it must donate its priority to the writer. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_rwlock_writer_pref (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_acquire_read (&rwlock);
+  msg ("main: holding the lock for reading");
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rwlock);
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rwlock);
+  if (rwlock_try_acquire_read (&rwlock))
+    fail ("new reader got in ahead of a waiting writer");
+  msg ("main: releasing the lock");
+  rwlock_release_read (&rwlock);
+  msg ("writer, then reader, must already have finished.");
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  msg ("writer: waiting for the lock");
+  rwlock_acquire_write (rwlock);
+  msg ("writer: got the lock, priority %d", thread_get_priority ());
+  rwlock_release_write (rwlock);
+  msg ("writer: done");
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  msg ("reader: waiting for the lock");
+  rwlock_acquire_read (rwlock);
+  msg ("reader: got the lock");
+  rwlock_release_read (rwlock);
+  msg ("reader: done");
+}
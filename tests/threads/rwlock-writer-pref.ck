@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-pref) begin
+(rwlock-writer-pref) main: holding the lock for reading
+(rwlock-writer-pref) writer: waiting for the lock
+(rwlock-writer-pref) reader: waiting for the lock
+(rwlock-writer-pref) main: releasing the lock
+(rwlock-writer-pref) writer: got the lock, priority 33
+(rwlock-writer-pref) reader: got the lock
+(rwlock-writer-pref) reader: done
+(rwlock-writer-pref) writer: done
+(rwlock-writer-pref) writer, then reader, must already have finished.
+(rwlock-writer-pref) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Checks that a read() system call into a buffer shared
+   copy-on-write with the parent breaks the sharing, so the
+   data the kernel writes is seen only by the child. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/sample.inc"
+
+static char buf[4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+	pid_t child;
+	void *pa_parent;
+	int handle;
+
+	memset (buf, 'x', sizeof buf);
+	pa_parent = get_phys_addr ((void *) buf);
+
+	child = fork ("child");
+	if (child == 0) {
+		CHECK (pa_parent == get_phys_addr ((void *) buf),
+				"two phys addrs should be the same.");
+
+		CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+		CHECK (read (handle, buf, strlen (sample)) == (int) strlen (sample),
+				"read \"sample.txt\" into shared buffer");
+		CHECK (memcmp (buf, sample, strlen (sample)) == 0, "check data change");
+		CHECK (pa_parent != get_phys_addr ((void *) buf),
+				"two phys addrs should not be the same.");
+		close (handle);
+		return;
+	}
+	wait (child);
+	CHECK (pa_parent == get_phys_addr ((void *) buf),
+			"two phys addrs should be the same.");
+	CHECK (buf[0] == 'x' && buf[sizeof buf - 1] == 'x'
+			&& memchr (buf, '=', sizeof buf) == NULL,
+			"check data consistency");
+	return;
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-read) begin
+(cow-read) two phys addrs should be the same.
+(cow-read) open "sample.txt"
+(cow-read) read "sample.txt" into shared buffer
+(cow-read) check data change
+(cow-read) two phys addrs should not be the same.
+(cow-read) end
+(cow-read) two phys addrs should be the same.
+(cow-read) check data consistency
+(cow-read) end
+EOF
+pass;
@@ -34,6 +34,8 @@
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/buffer_cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -221,16 +223,33 @@ parse_options (char **argv) {
 #ifdef FILESYS
 		else if (!strcmp (name, "-f"))
 			format_filesys = true;
+		else if (!strcmp (name, "-dma"))
+			disk_dma_enabled = true;
+		else if (!strcmp (name, "-wb-age"))
+			buffer_cache_dirty_age = atoi (value);
+		else if (!strcmp (name, "-wb-ratio")) {
+			buffer_cache_dirty_ratio = atoi (value);
+			if (buffer_cache_dirty_ratio < 0 || buffer_cache_dirty_ratio > 100)
+				PANIC ("-wb-ratio must be between 0 and 100");
+		}
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-vm-policy")) {
+			if (value == NULL || !replace_set_policy (value))
+				PANIC ("unknown page replacement policy `%s'", value);
+		}
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -277,6 +296,7 @@ run_actions (char **argv) {
 		{"rm", 2, fsutil_rm},
 		{"put", 2, fsutil_put},
 		{"get", 2, fsutil_get},
+		{"df", 1, fsutil_df},
 #endif
 		{NULL, 0, NULL},
 	};
@@ -322,6 +342,7 @@ usage (void) {
 			"  ls                 List files in the root directory.\n"
 			"  cat FILE           Print FILE to the console.\n"
 			"  rm FILE            Delete FILE.\n"
+			"  df                 Show free space and fragmentation.\n"
 			"Use these actions indirectly via `pintos' -g and -p options:\n"
 			"  put FILE           Put FILE into file system from scratch disk.\n"
 			"  get FILE           Get FILE from file system into scratch disk.\n"
@@ -332,8 +353,17 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
+#ifdef FILESYS
+			"  -dma               Use bus-master IDE DMA when available.\n"
+			"  -wb-age=TICKS      Write back dirty cached sectors after TICKS.\n"
+			"  -wb-ratio=PCT      Write back early once PCT%% of the cache is dirty.\n"
+#endif
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -vm-policy=NAME    Page replacement: clock, wsclock or lru-k.\n"
 #endif
 			);
 	power_off ();
@@ -362,10 +392,18 @@ print_stats (void) {
 	thread_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+	buffer_cache_print_stats ();
+	dcache_print_stats ();
+#ifdef EFILESYS
+	fat_print_stats ();
+#endif
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
 }
@@ -80,10 +80,10 @@ sema_down (struct semaphore *sema) {
 	// thread_current() = 여기는 여러가지 스레드들이 들어온다.
 	while (sema->value == 0) {
 		/* 
-		thread_current() = 이미 락을 점유하고 있는 스레드보다 우선순위가 높아서 점유할려고 들어왔다 
-		sema->waiters(리스트)에 입력할때 우선순위가 높은 순으로 정렬해서 입력한다.
+		대기자의 우선순위는 기부로 바뀔 수 있으므로 넣을 때 정렬하지 않고
+		sema_up 에서 가장 높은 스레드를 고른다.
 		*/
-		list_insert_ordered(&sema->waiters, &thread_current()->elem,thread_compare_priority,0);
+		list_push_back(&sema->waiters, &thread_current()->elem);
 		// 준비과정이 끝나면 thread_current() 를 잠재운다.
 		thread_block ();
 	}
@@ -141,15 +141,16 @@ sema_up (struct semaphore *sema) {
 	/* 락에 대기중인 스레드가 존재한다면 */
 	if (!list_empty (&sema->waiters)){
 		/* 
-		sema_up 에서 정렬하더라도 락에서 스레드를 공유하고 우선순위 기부로 인한 
-		우선 순위가 바뀔 수 있기 때문에 unblock 전에 정렬을 해줘야한다.
+		대기 중에 우선순위 기부로 우선순위가 바뀔 수 있기 때문에
+		깨울 때 가장 높은 스레드를 찾는다. 정렬 대신 한 번 훑기만 하고,
+		같은 우선순위끼리는 먼저 온 스레드가 먼저 깬다.
 		예시) priority-donate-sema 테스트 케이스
 		*/
-		list_sort(&sema->waiters,thread_compare_priority,0);
-		// waiters 에서 우선순위 높은 스레드를 먼저 깨운다.
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
-		
+		struct list_elem *e = list_min (&sema->waiters,
+				thread_compare_priority, 0);
+		list_remove (e);
+		thread_unblock (list_entry (e, struct thread, elem));
+
 	}
 
 	sema->value++;
@@ -260,7 +261,8 @@ lock_acquire (struct lock *lock) {
 	우선적으로 기부하세요.*/
 	// thread_current() = 여러가지 스레드들이 들어올 수있다.
 
-	if(lock->holder){
+	/* mlfqs 에서는 우선순위 기부를 하지 않는다 */
+	if(!thread_mlfqs && lock->holder){
 		/* 
 		thread_current() = 이미 락을 점유하고 있는 스레드보다 우선순위가 높아서 점유할려고 들어왔다 
 		현재 스레드에 락을 입력해준다.
@@ -319,7 +321,7 @@ lock_release (struct lock *lock) {
 	*/
 	// thread_current() = 여러가지 스레드들이 들어올 수있다.
 	// 락에 대기중인 스레드가 있다면
-	if(!list_empty (&lock->semaphore.waiters)){
+	if(!thread_mlfqs && !list_empty (&lock->semaphore.waiters)){
 		thread_remove_donate(lock);
 		thread_donate_reset(lock->holder);
 	}
@@ -340,6 +342,128 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
+/* Initializes RWLOCK.  Readers and writers are not recursive: a
+   thread that already holds RWLOCK in either mode must not acquire
+   it again, since a writer queued in between would deadlock. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	rw->readers = 0;
+	rw->writer_waiting = false;
+	sema_init (&rw->drained, 0);
+}
+
+/* Acquires RWLOCK for reading, sleeping while a writer holds it or
+   waits for it.  The internal lock is held only long enough to
+   register as a reader, so readers run concurrently, while a
+   reader blocked behind a writer donates its priority to it. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	rw->readers++;
+	intr_set_level (old_level);
+	lock_release (&rw->lock);
+}
+
+/* Tries to acquire RWLOCK for reading without sleeping.  Fails if
+   a writer holds or waits for it. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+
+	if (!lock_try_acquire (&rw->lock))
+		return false;
+	old_level = intr_disable ();
+	rw->readers++;
+	intr_set_level (old_level);
+	lock_release (&rw->lock);
+	return true;
+}
+
+/* Releases a read hold on RWLOCK.  The last reader out wakes the
+   writer waiting for the readers to drain, if any. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+
+	old_level = intr_disable ();
+	ASSERT (rw->readers > 0);
+	if (--rw->readers == 0 && rw->writer_waiting) {
+		rw->writer_waiting = false;
+		sema_up (&rw->drained);
+	}
+	intr_set_level (old_level);
+}
+
+/* Acquires RWLOCK for writing.  Taking the internal lock first
+   shuts out new readers; then we wait for the current ones to
+   leave.  Interrupts stay off between the check and the sleep so
+   the last reader cannot slip past us. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	while (rw->readers > 0) {
+		rw->writer_waiting = true;
+		sema_down (&rw->drained);
+	}
+	intr_set_level (old_level);
+}
+
+/* Tries to acquire RWLOCK for writing without sleeping.  Fails if
+   it is held in either mode. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw) {
+	bool success;
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+
+	if (!lock_try_acquire (&rw->lock))
+		return false;
+	old_level = intr_disable ();
+	success = rw->readers == 0;
+	intr_set_level (old_level);
+	if (!success)
+		lock_release (&rw->lock);
+	return success;
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RWLOCK for writing.
+   Read holds are anonymous and cannot be checked. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return lock_held_by_current_thread (&rw->lock) && rw->readers == 0;
+}
+
 /* One semaphore in a list. */
 /* 리스트 내의 하나의 세마포어입니다. */
 struct semaphore_elem {
@@ -404,8 +528,8 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	sema_init (&waiter.semaphore, 0);
-	/* 우선 순위가 높은 순으로 정렬해서 cond_waiters에 입력한다*/
-	list_insert_ordered(&cond->waiters, &waiter.elem,cond_compare_waiter,0);
+	/* 깨울 때 cond_signal 이 가장 높은 우선순위를 고르므로 뒤에 붙이기만 한다*/
+	list_push_back (&cond->waiters, &waiter.elem);
 	lock_release (lock);
 	sema_down (&waiter.semaphore);
 	lock_acquire (lock);
@@ -431,11 +555,12 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 	/*조건 변수에서 대기 중인 가장 높은 우선 순위의 스레드에 신호를 보냅니다.*/
-	if (!list_empty (&cond->waiters))
-		/* sema_up 하기 전에 리스트를 정렬을 다시 한번 해준다.*/
-		list_sort(&cond->waiters,cond_compare_waiter,0);
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+	if (!list_empty (&cond->waiters)) {
+		/* 정렬하지 않고 우선순위가 가장 높은 대기자를 찾아서 깨운다.*/
+		struct list_elem *e = list_min (&cond->waiters, cond_compare_waiter, 0);
+		list_remove (e);
+		sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+	}
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -10,6 +10,7 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,11 +25,20 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-/* THREAD_READY 상태인 프로세스들의 목록입니다.
-즉, 실행 준비가 된 상태이지만 실제로 실행 중인 것은 아닙니다. */
-static struct list ready_list;
+/* Lists of processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running, one FIFO per
+   priority.  Bit P of ready_mask is set iff ready_queues[P] is
+   non-empty, so the highest ready priority is found with a single
+   bit scan. */
+/* THREAD_READY 상태인 프로세스들의 목록입니다. 우선순위마다 FIFO 큐가
+하나씩 있고, ready_mask의 P번 비트는 ready_queues[P]가 비어 있지 않을 때만
+켜져 있으므로 가장 높은 우선순위를 비트 검색 한 번으로 찾습니다. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static int ready_cnt;          /* 준비 큐에 있는 스레드 수 */
+
+/* 살아 있는 모든 스레드의 목록 */
+static struct list all_list;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -49,6 +59,7 @@ static struct list destruction_req;
 static long long idle_ticks;   /* # of timer ticks spent idle. */
 static long long kernel_ticks; /* # of timer ticks in kernel threads. */
 static long long user_ticks;   /* # of timer ticks in user programs. */
+static long long idle_interrupts; /* # of timer interrupts taken while idle. */
 
 /* Scheduling. */
 #define TIME_SLICE 4		  /* # of timer ticks to give each thread. */
@@ -59,10 +70,22 @@ static unsigned thread_ticks; /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* mlfqs: 시스템 부하 평균 */
+static fixed_t load_avg;
+
+/* mlfqs: 마지막 우선순위 재계산 이후 recent_cpu 가 바뀐 스레드들.
+   4틱마다 이 스레드들의 우선순위만 다시 계산한다. */
+static struct list cpu_list;
+
 static void kernel_thread(thread_func *, void *aux);
 
 static void idle(void *aux UNUSED);
 static struct thread *next_thread_to_run(void);
+static void ready_push(struct thread *);
+static void ready_remove(struct thread *);
+static int ready_max_priority(void);
+static void thread_update_priority(struct thread *, int priority);
+static void mlfqs_tick(struct thread *);
 static void init_thread(struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule(void);
@@ -89,11 +112,69 @@ static uint64_t gdt[3] = {0, 0x00af9a000000ffff, 0x00cf92000000ffff};
 
 /*-----Alarm Clock---------------------------------------------------------*/
 
-static struct list sleep_list;
+/*
+잠든 스레드들을 깨어날 틱으로 분류해 두는 계층형 타이밍 휠.
+WHEEL_LEVELS 개의 단계마다 WHEEL_SLOTS 개의 칸이 있고, L 단계의 칸 하나는
+WHEEL_SLOTS^L 틱을 담당한다. 0단계의 칸에는 정확히 그 틱에 깨어날 스레드만
+들어 있다. 윗 단계의 칸은 그 구간이 시작될 때 아래 단계로 다시 나눠 넣는다.
+넣기는 리스트 push 한 번이고, 매 틱에 하는 일은 깨울 스레드 수와
+내려보낼 칸 하나에 비례하므로 잠든 스레드 수와 상관없이 인터럽트를 끄는
+시간이 짧다.
+*/
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint64_t wheel_mask[WHEEL_LEVELS]; /* 비어 있지 않은 칸의 비트 */
+static int64_t wheel_time;                /* 아직 처리하지 않은 가장 이른 틱 */
+static int sleeper_cnt;                   /* 휠에 있는 스레드 수 */
+static int wakeup_max_work;               /* 한 틱에 깨우거나 옮긴 스레드 수의 최댓값 */
+
+/* 잠든 스레드 T를 wakeup_tick 에 맞는 칸에 넣는다.
+   이미 지난 틱이면 다음에 처리할 틱에 깨운다. 휠의 범위를 넘는 틱은
+   가장 먼 칸에 넣어 두면 내려올 때 다시 분류된다. */
+static void wheel_insert(struct thread *t)
+{
+	int64_t expires = t->wakeup_tick;
+	int64_t delta;
+	int level;
+	int slot;
+
+	if (expires < wheel_time)
+		expires = wheel_time;
+	delta = expires - wheel_time;
+	if (delta >= WHEEL_SPAN)
+		expires = wheel_time + WHEEL_SPAN - 1;
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+			break;
+	slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	list_push_back(&wheel[level][slot], &t->elem);
+	wheel_mask[level] |= 1ULL << slot;
+}
+
+/* LEVEL 단계의 SLOT 칸에 있는 스레드들을 아래 단계로 다시 나눠 넣고
+   옮긴 스레드 수를 돌려준다 */
+static int wheel_cascade(int level, int slot)
+{
+	struct list *bucket = &wheel[level][slot];
+	int cnt = 0;
+
+	while (!list_empty(bucket)) {
+		wheel_insert(list_entry(list_pop_front(bucket), struct thread, elem));
+		cnt++;
+	}
+	wheel_mask[level] &= ~(1ULL << slot);
+	return cnt;
+}
 
 /*
 스레드를 잠재우는 함수 틱수를 받아서 그만큼 잠들게 스레드 wakeup-tick 에 틱수 저장후
-슬림리스트에 저장하고 thread_block() 함수를 실행 잠드는 시간이 짧을 수록 맨 앞에 넣는다.
+타이밍 휠에 넣고 thread_block() 함수를 실행한다.
 */
 void thread_sleep(int64_t ticks)
 {
@@ -102,16 +183,15 @@ void thread_sleep(int64_t ticks)
 	struct thread * t = thread_current();
 	/*
 	현재 스레드가 idle 스레드가 아니라면 
-	스레드를 sleep_list 에 스레드를 넣고
-	재운다.
+	스레드를 휠에 넣고 재운다.
 	*/ 
 	ASSERT (!intr_context ());
 	/* 현재 스레드가 idle 스레드가 아니라면 */
 	if (t != idle_thread){
 		/* 로컬 틱을 설정한다 */
 		t->wakeup_tick = ticks;
-		/* 로컬 틱이 작은 순으로 정렬해서 sleep_list를 정렬한다 */
-		list_insert_ordered(&sleep_list, &t->elem,thread_compare_time,0);
+		wheel_insert(t);
+		sleeper_cnt++;
 		/* 스레드를 잠재운다 */
 		thread_block();
 	}
@@ -121,31 +201,91 @@ void thread_sleep(int64_t ticks)
 
 /* 
 타이머 인터럽트에서 글로벌 틱수를 받아와서 
-슬립 리스트에 가장 짧게 잠드는 스레드와 글로벌 틱수를 비교해서
-시간이 되면 thread_unblock() 함수를 블러온다.
+TICKS 까지의 틱을 차례로 처리하면서 깨어날 시간이 된 스레드를
+thread_unblock() 한다.
 */
 void thread_wakeup(int64_t ticks){
 	enum intr_level old_level;
 	old_level = intr_disable();
 
-	/* 
-	sleep_list에 스레드가 존재하고 sleep_list의 첫번째 스레드가 글로벌 틱수보다 같거나 높다면 
-	첫번째 스레드를 pop 해주면서 unblock()에 호출해 준다.
-	*/
-	while(!list_empty(&sleep_list) && 
-		list_entry(list_front(&sleep_list), struct thread, elem)->wakeup_tick <= ticks){
-		thread_unblock(list_entry(list_pop_front(&sleep_list), struct thread, elem));
+	/* 잠든 스레드가 없으면 휠을 돌릴 필요가 없다 */
+	if (sleeper_cnt == 0 && wheel_time <= ticks)
+		wheel_time = ticks + 1;
+
+	while (wheel_time <= ticks) {
+		int slot = wheel_time & WHEEL_MASK;
+		struct list *bucket = &wheel[0][slot];
+		int work = 0;
+
+		/* 0단계가 한 바퀴 돌았으면 윗 단계에서 이번 구간의 칸을 내려보낸다 */
+		if (slot == 0) {
+			int level;
+			for (level = 1; level < WHEEL_LEVELS; level++) {
+				int upper = (wheel_time >> (WHEEL_BITS * level)) & WHEEL_MASK;
+				work += wheel_cascade(level, upper);
+				if (upper != 0)
+					break;
+			}
+		}
+
+		while (!list_empty(bucket)) {
+			thread_unblock(list_entry(list_pop_front(bucket), struct thread, elem));
+			sleeper_cnt--;
+			work++;
+		}
+		wheel_mask[0] &= ~(1ULL << slot);
+		wheel_time++;
+		if (work > wakeup_max_work)
+			wakeup_max_work = work;
 	}
 
+	/* 깨운 스레드가 지금 스레드보다 우선순위가 높으면 인터럽트가 끝날 때 양보한다 */
+	if (intr_context() && ready_max_priority() > thread_current()->priority)
+		intr_yield_on_return();
+
 	intr_set_level(old_level);
 }
 
-// 스레드의 로컬 타임 비교 전자가 더 높으면 false 후자가 높으면 true
-bool thread_compare_time(const struct list_elem *a,
-							 const struct list_elem *b,
-							 void *aux)
+/*
+부팅 후 thread_wakeup() 이 한 틱을 처리하면서 인터럽트를 끈 채로 깨우거나
+아래 단계로 옮긴 스레드 수의 최댓값을 돌려준다. 인터럽트를 끄는 시간은
+이 값에 비례하므로 테스트가 그 한계를 확인할 때 쓴다.
+*/
+int thread_wakeup_max_work(void)
 {
-	return list_entry(a, struct thread, elem)->wakeup_tick <= list_entry(b, struct thread, elem)->wakeup_tick;
+	return wakeup_max_work;
+}
+
+/*
+다음에 깨울 스레드가 있는 틱의 하한을 돌려준다. 잠든 스레드가 없으면 INT64_MAX.
+0단계에서는 비트 검색으로 가장 가까운 칸을 찾고, 윗 단계에 스레드가 있으면
+다음 내려보내기 시점을 넘기지 않는다. tickless idle 이 타이머를 얼마나
+멈출지 정할 때 쓴다. 인터럽트가 꺼진 상태에서 호출해야 한다.
+*/
+int64_t thread_next_wakeup(void)
+{
+	int64_t next = INT64_MAX;
+	int level;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (sleeper_cnt == 0)
+		return next;
+
+	if (wheel_mask[0] != 0) {
+		int cur = wheel_time & WHEEL_MASK;
+		uint64_t m = wheel_mask[0];
+		uint64_t rotated = cur == 0 ? m : (m >> cur) | (m << (WHEEL_SLOTS - cur));
+		next = wheel_time + __builtin_ctzll(rotated);
+	}
+	for (level = 1; level < WHEEL_LEVELS; level++)
+		if (wheel_mask[level] != 0) {
+			int64_t cascade = (wheel_time | WHEEL_MASK) + 1;
+			if (cascade < next)
+				next = cascade;
+			break;
+		}
+	return next;
 }
 
 /*------------------------------------------------------------------------*/
@@ -172,6 +312,8 @@ bool thread_compare_time(const struct list_elem *a,
 이 함수가 완료될 때까지 thread_current()를 호출하는 것은 안전하지 않습니다. */
 void thread_init(void)
 {
+	int i;
+
 	ASSERT(intr_get_level() == INTR_OFF);
 
 	/* Reload the temporal gdt for the kernel
@@ -187,10 +329,23 @@ void thread_init(void)
 
 	/* Init the globla thread context */
 	lock_init(&tid_lock);
-	list_init(&ready_list);
+	for (i = 0; i <= PRI_MAX; i++)
+		list_init(&ready_queues[i]);
+	ready_mask = 0;
+	ready_cnt = 0;
+	list_init(&all_list);
+	list_init(&cpu_list);
+	load_avg = 0;
 	list_init(&destruction_req);
-	// sleep_list 초기화
-	list_init(&sleep_list);
+	// 타이밍 휠 초기화
+	for (i = 0; i < WHEEL_LEVELS; i++) {
+		int j;
+		for (j = 0; j < WHEEL_SLOTS; j++)
+			list_init(&wheel[i][j]);
+		wheel_mask[i] = 0;
+	}
+	wheel_time = 0;
+	sleeper_cnt = 0;
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread();
@@ -225,8 +380,10 @@ void thread_tick(void)
 {
 	struct thread *t = thread_current();
 
-	if (t == idle_thread)
+	if (t == idle_thread) {
 		idle_ticks++;
+		idle_interrupts++;
+	}
 #ifdef USERPROG
 	else if (t->pml4 != NULL)
 		user_ticks++;
@@ -234,6 +391,9 @@ void thread_tick(void)
 	else
 		kernel_ticks++;
 
+	if (thread_mlfqs)
+		mlfqs_tick(t);
+
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return();
@@ -244,6 +404,16 @@ void thread_print_stats(void)
 {
 	printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 		   idle_ticks, kernel_ticks, user_ticks);
+	if (timer_tickless)
+		printf("Thread: %lld timer interrupts while idle\n", idle_interrupts);
+}
+
+/* Accounts for N idle ticks that passed without a timer interrupt,
+   while the tick was stopped in tickless idle. */
+/* tickless 모드에서 타이머 인터럽트 없이 지나간 N 개의 idle 틱을 기록합니다. */
+void thread_idle_ticks(int64_t n)
+{
+	idle_ticks += n;
 }
 
 /* thread_create() 추가사항 */
@@ -316,7 +486,7 @@ tid_t thread_create(const char *name, int priority,
 	list_push_back(&thread_current()->children,&t->child_elem);
 
 
-	/* 스레드를 만들어서 ready_list 에 입력했으니까 비교를 한번 해준다*/
+	/* 스레드를 만들어서 준비 큐에 입력했으니까 비교를 한번 해준다*/
 	thread_compare();
 
 	return tid;
@@ -368,8 +538,7 @@ void thread_unblock(struct thread *t)
 
 	old_level = intr_disable();
 	ASSERT(t->status == THREAD_BLOCKED);
-	// ready_list에 스레드를 입력할때 우선순위 높은 순으로 정렬해서 입력한다
-	list_insert_ordered(&ready_list, &t->elem, thread_compare_priority, 0);
+	ready_push(t);
 	t->status = THREAD_READY;
 	intr_set_level(old_level);
 }
@@ -432,6 +601,9 @@ void thread_exit(void)
 	/* 우리의 상태를 종료 중으로 설정하고 다른 프로세스를 스케줄합니다.
 	schedule_tail() 호출 중에 우리는 파괴될 것입니다. */
 	intr_disable();
+	list_remove(&thread_current()->all_elem);
+	if (thread_current()->cpu_dirty)
+		list_remove(&thread_current()->cpu_elem);
 	do_schedule(THREAD_DYING);
 	NOT_REACHED();
 }
@@ -449,15 +621,56 @@ void thread_yield(void)
 
 	ASSERT(!intr_context());
 	old_level = intr_disable();
-	if (curr != idle_thread){
-		list_insert_ordered(&ready_list, &curr->elem, thread_compare_priority, 0);
-	}
+	if (curr != idle_thread)
+		ready_push(curr);
 	do_schedule(THREAD_READY);
 	intr_set_level(old_level);
 }
 
 /*-----priority scheduling-----------------------------------------------*/
 
+/* 준비된 스레드 T를 자기 우선순위 큐의 맨 뒤에 넣는다.
+   인터럽트가 꺼진 상태에서 호출해야 한다. */
+static void ready_push(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+	list_push_back(&ready_queues[t->priority], &t->elem);
+	ready_mask |= 1ULL << t->priority;
+	ready_cnt++;
+}
+
+/* 준비 큐에 있는 스레드 T를 꺼낸다. 큐가 비면 비트도 끈다. */
+static void ready_remove(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+	list_remove(&t->elem);
+	if (list_empty(&ready_queues[t->priority]))
+		ready_mask &= ~(1ULL << t->priority);
+	ready_cnt--;
+}
+
+/* 준비된 스레드 중 가장 높은 우선순위, 없으면 -1.
+   bsr 한 번으로 끝난다. */
+static int ready_max_priority(void)
+{
+	return ready_mask != 0 ? 63 - __builtin_clzll(ready_mask) : -1;
+}
+
+/* T의 (기부를 포함한) 실제 우선순위를 PRIORITY로 바꾼다.
+   T가 준비 큐에 있다면 새 우선순위의 큐 맨 뒤로 옮긴다. */
+static void thread_update_priority(struct thread *t, int priority)
+{
+	enum intr_level old_level = intr_disable();
+
+	if (t->status == THREAD_READY && t->priority != priority) {
+		ready_remove(t);
+		t->priority = priority;
+		ready_push(t);
+	} else
+		t->priority = priority;
+	intr_set_level(old_level);
+}
+
 // 우선순위 비교 전자 가 후자보다 크다면 true
 bool thread_compare_priority(const struct list_elem *a,
 							 const struct list_elem *b,
@@ -472,19 +685,12 @@ bool thread_compare_priority(const struct list_elem *a,
 */
 void thread_compare(void)
 {
-	// ready_list에 스레드가 존재한다면
-	if (!intr_context() && !list_empty(&ready_list))
-	{
-		/*
-		현재 실행중인 스레드와 ready_list에 우선순위가 가장 높은 스레드와 비교해서
-		실행 중인 스레드가 낮다면 thread_yield()를 호출해서 실행 중인 스레드를 잠재운다.
-		*/ 
-		if (thread_compare_priority(&list_entry(list_front(&ready_list), struct thread, elem)->elem,
-									&thread_current()->elem, 0))
-		{
-			thread_yield();
-		}
-	}
+	/*
+	현재 실행중인 스레드와 준비 큐에서 우선순위가 가장 높은 스레드와 비교해서
+	실행 중인 스레드가 낮다면 thread_yield()를 호출해서 실행 중인 스레드를 잠재운다.
+	*/
+	if (!intr_context() && ready_max_priority() > thread_current()->priority)
+		thread_yield();
 }
 
 /*-----------------------------------------------------------------------*/
@@ -495,9 +701,12 @@ void thread_compare(void)
 void thread_set_priority(int new_priority)
 {
 	struct thread *t = thread_current();
-	t->priority = new_priority;
+
+	/* mlfqs 에서는 스케줄러가 우선순위를 정한다 */
+	if (thread_mlfqs)
+		return;
 	t->init_priority = new_priority;
-	
+
 	thread_donate_reset(t);
 	thread_compare();
 }
@@ -561,16 +770,18 @@ bool thread_compare_donate_priority(const struct list_elem *a,
 /* 기부 받은 스레드가 변경 되었다면 리셋 해줘야한다*/
 void thread_donate_reset(struct thread *t){
 	// 기본적으로 본래 자신의 우선순위로 갱신
-	t->priority = t->init_priority;
-	
-	if(!list_empty(&t->donations)){
-		// 혹시라도 donations 리스트가 정렬이 안될 수 도 있기 때문에 정렬한다
-		list_sort(&t->donations,thread_compare_donate_priority,0);
+	int priority = t->init_priority;
+	enum intr_level old_level = intr_disable();
 
-		if(t->priority < list_entry (list_front (&t->donations), struct thread, elem)->priority){
-			t->priority = list_entry (list_front (&t->donations), struct thread, elem)->priority;
-		}
+	if(!list_empty(&t->donations)){
+		// 기부자들의 우선순위는 그 사이 바뀌었을 수 있으므로 정렬 대신 최댓값만 찾는다
+		struct thread *top = list_entry (list_min (&t->donations,
+					thread_compare_donate_priority, 0), struct thread, d_elem);
+		if(priority < top->priority)
+			priority = top->priority;
 	}
+	thread_update_priority(t, priority);
+	intr_set_level(old_level);
 }
 
 /* 락을 점유하고 있는 스레드들에게 현재 스레드의 우선순위를 기부한다.*/
@@ -583,8 +794,9 @@ void thread_donate_depth(void){
 		if (!curr->wait_on_lock) break;
 		// 락을 점유하고 있는 스레드를 다 순회 한다.
 		struct thread *holder = curr->wait_on_lock->holder;
-		// 현재 우선순위가 가장 큰 값이므로 현재 우선순위로 변경 해준다.
-		holder->priority = curr->priority;
+		// 기부는 우선순위를 올리기만 한다. 준비 큐에 있다면 큐도 옮겨진다.
+		if (holder->priority < curr->priority)
+			thread_update_priority(holder, curr->priority);
 		// 다음 락을 점유 하고 있는 스레드로 바꿔준다.
 		curr = holder;
 	}
@@ -593,38 +805,134 @@ void thread_donate_depth(void){
 
 /*------------------------------------------------------------------------*/
 
+/*-----mlfqs-------------------------------------------------------------*/
+
+/* T의 nice 와 recent_cpu 로 계산한 mlfqs 우선순위
+   priority = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
+static int mlfqs_priority(struct thread *t)
+{
+	int priority = fp_to_int(fp_sub(fp_from_int(PRI_MAX - t->nice * 2),
+									fp_div_int(t->recent_cpu, 4)));
+
+	if (priority < PRI_MIN)
+		return PRI_MIN;
+	if (priority > PRI_MAX)
+		return PRI_MAX;
+	return priority;
+}
+
+/* T의 recent_cpu 가 바뀌었으니 다음 재계산 때 우선순위를 다시 구하도록 표시한다 */
+static void mlfqs_mark(struct thread *t)
+{
+	if (!t->cpu_dirty) {
+		t->cpu_dirty = true;
+		list_push_back(&cpu_list, &t->cpu_elem);
+	}
+}
+
+/* 1초마다 load_avg 와 모든 스레드의 recent_cpu 를 갱신한다.
+   load_avg = (59/60) * load_avg + (1/60) * ready_threads
+   recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice
+   recent_cpu 와 nice 가 모두 0인 스레드는 값이 바뀌지 않으므로 건너뛴다.
+   대부분 잠들어 있는 스레드들이 여기에 해당한다. */
+static void mlfqs_second(struct thread *curr)
+{
+	int ready_threads = ready_cnt + (curr != idle_thread ? 1 : 0);
+	fixed_t twice_load;
+	fixed_t coef;
+	struct list_elem *e;
+
+	load_avg = fp_add(fp_mul(fp_div_int(fp_from_int(59), 60), load_avg),
+					  fp_mul_int(fp_div_int(fp_from_int(1), 60), ready_threads));
+
+	twice_load = fp_mul_int(load_avg, 2);
+	coef = fp_div(twice_load, fp_add_int(twice_load, 1));
+	for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
+		struct thread *t = list_entry(e, struct thread, all_elem);
+
+		if (t == idle_thread || (t->recent_cpu == 0 && t->nice == 0))
+			continue;
+		t->recent_cpu = fp_add_int(fp_mul(coef, t->recent_cpu), t->nice);
+		mlfqs_mark(t);
+	}
+}
+
+/* 타이머 틱마다 불린다. 실행 중인 스레드의 recent_cpu 를 올리고,
+   1초마다 부하를 갱신하고, 4틱마다 recent_cpu 가 바뀐 스레드들의
+   우선순위만 다시 계산한다. */
+static void mlfqs_tick(struct thread *curr)
+{
+	int64_t ticks = timer_ticks();
+
+	if (curr != idle_thread) {
+		curr->recent_cpu = fp_add_int(curr->recent_cpu, 1);
+		mlfqs_mark(curr);
+	}
+
+	if (ticks % TIMER_FREQ == 0)
+		mlfqs_second(curr);
+
+	if (ticks % 4 == 0) {
+		while (!list_empty(&cpu_list)) {
+			struct thread *t = list_entry(list_pop_front(&cpu_list),
+										  struct thread, cpu_elem);
+			t->cpu_dirty = false;
+			thread_update_priority(t, mlfqs_priority(t));
+		}
+		if (ready_max_priority() > curr->priority)
+			intr_yield_on_return();
+	}
+}
+
 /* Sets the current thread's nice value to NICE. */
 /* 현재 스레드의 nice 값을 NICE로 설정합니다. */
-void thread_set_nice(int nice UNUSED)
+void thread_set_nice(int nice)
 {
-	/* TODO: Your implementation goes here */
+	struct thread *t = thread_current();
+	enum intr_level old_level;
+
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	if (nice > NICE_MAX)
+		nice = NICE_MAX;
+
+	old_level = intr_disable();
+	t->nice = nice;
+	/* mlfqs 가 아니면 nice 는 우선순위에 영향을 주지 않는다 */
+	if (thread_mlfqs)
+		thread_update_priority(t, mlfqs_priority(t));
+	intr_set_level(old_level);
+
+	// 우선순위가 내려갔다면 양보한다
+	if (thread_mlfqs)
+		thread_compare();
 }
 
 /* Returns the current thread's nice value. */
 /* 현재 스레드의 nice 값을 반환합니다. */
 int thread_get_nice(void)
 {
-	/* TODO: Your implementation goes here */
-
-	return 0;
+	return thread_current()->nice;
 }
 
 /* Returns 100 times the system load average. */
 /* 시스템 로드 평균의 100배를 반환합니다. */
 int thread_get_load_avg(void)
 {
-	/* TODO: Your implementation goes here */
-
-	return 0;
+	enum intr_level old_level = intr_disable();
+	int load = fp_round(fp_mul_int(load_avg, 100));
+	intr_set_level(old_level);
+	return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 /* 현재 스레드의 recent_cpu 값의 100배를 반환합니다. */
 int thread_get_recent_cpu(void)
 {
-	/* TODO: Your implementation goes here */
-
-	return 0;
+	enum intr_level old_level = intr_disable();
+	int recent = fp_round(fp_mul_int(thread_current()->recent_cpu, 100));
+	intr_set_level(old_level);
+	return recent;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -658,6 +966,9 @@ idle(void *idle_started_ UNUSED)
 		intr_disable();
 		thread_block();
 
+		/* tickless 모드라면 다음 타이머 이벤트까지 주기적인 틱을 멈춘다. */
+		timer_idle_enter(thread_next_wakeup());
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -705,6 +1016,8 @@ kernel_thread(thread_func *function, void *aux)
 static void
 init_thread(struct thread *t, const char *name, int priority)
 {
+	enum intr_level old_level;
+
 	ASSERT(t != NULL);
 	ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT(name != NULL);
@@ -713,6 +1026,14 @@ init_thread(struct thread *t, const char *name, int priority)
 	t->status = THREAD_BLOCKED;
 	strlcpy(t->name, name, sizeof t->name);
 	t->tf.rsp = (uint64_t)t + PGSIZE - sizeof(void *);
+	/* mlfqs: nice 와 recent_cpu 는 부모에게 물려받고 우선순위는 그 둘로 정한다 */
+	if (thread_mlfqs) {
+		if (t != initial_thread) {
+			t->nice = thread_current()->nice;
+			t->recent_cpu = thread_current()->recent_cpu;
+		}
+		priority = mlfqs_priority(t);
+	}
 	t->priority = priority;
 	/* project 1  초기화*/
 	t->init_priority = priority;
@@ -729,7 +1050,9 @@ init_thread(struct thread *t, const char *name, int priority)
 	//t->donate_priority = priority;
 	t->magic = THREAD_MAGIC;
 
-	
+	old_level = intr_disable();
+	list_push_back(&all_list, &t->all_elem);
+	intr_set_level(old_level);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -744,10 +1067,14 @@ init_thread(struct thread *t, const char *name, int priority)
 static struct thread *
 next_thread_to_run(void)
 {
-	if (list_empty(&ready_list))
+	int priority = ready_max_priority();
+	struct thread *t;
+
+	if (priority < 0)
 		return idle_thread;
-	else
-		return list_entry(list_pop_front(&ready_list), struct thread, elem);
+	t = list_entry(list_front(&ready_queues[priority]), struct thread, elem);
+	ready_remove(t);
+	return t;
 }
 
 /* Use iretq to launch the thread */
@@ -902,6 +1229,10 @@ schedule(void)
 	ASSERT(curr->status != THREAD_RUNNING);
 	ASSERT(is_thread(next));
 
+	/* idle 에서 벗어나면 멈췄던 틱을 되돌린다. */
+	if (curr == idle_thread && next != idle_thread)
+		timer_idle_exit();
+
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
 
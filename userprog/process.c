@@ -254,10 +254,8 @@ process_exec (void *f_name) {
 	// hash_destroy() 호출하면 아예없어서 init을 새로 해줘야했다.
 	// supplemental_page_table_init(&thread_current()->spt);
 
-	lock_acquire(&filesys_lock);
 	/* And then load the binary */
 	success = load (file_name, &_if);
-	lock_release(&filesys_lock);
 	/* If load failed, quit. */
 	palloc_free_page (file_name);
 	if (!success){
@@ -938,7 +936,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		fp->zero_bytes = page_zero_bytes;
 		
 
-		if(!vm_alloc_page_with_initializer(VM_ANON,upage,writable,lazy_load_segment, fp)){
+		// VM_MARKER_1: 읽기 전용 세그먼트는 같은 프로그램을 실행하는 프로세스끼리 공유
+		enum vm_type type = writable ? VM_ANON : VM_ANON | VM_MARKER_1;
+		if(!vm_alloc_page_with_initializer(type,upage,writable,lazy_load_segment, fp)){
 			return false;
 		}
 
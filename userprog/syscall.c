@@ -65,8 +65,6 @@ syscall 명령은 Model Specific Register (MSR)에서 값을 읽어옴으로써
 
 void
 syscall_init (void) {
-	lock_init(&filesys_lock);
-
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
 			((uint64_t)SEL_KCSEG) << 32);
 	write_msr(MSR_LSTAR, (uint64_t) syscall_entry);
@@ -209,9 +207,7 @@ bool sc_create(struct intr_frame *f){
 
 	ptr_check(file_create_name);
 
-	lock_acquire(&filesys_lock);
 	bool success = filesys_create(file_create_name,initial_size);
-	lock_release(&filesys_lock);
 
 	return success; 
 }
@@ -222,9 +218,7 @@ bool sc_remove(struct intr_frame *f){
 
 	ptr_check(file_remove_name);
 
-	lock_acquire(&filesys_lock);
 	bool success = filesys_remove(file_remove_name);
-	lock_release(&filesys_lock);
 
 	return success;
 }
@@ -237,7 +231,6 @@ int sc_open(struct intr_frame *f){
 
 	ptr_check(file_open_name);
 
-	lock_acquire(&filesys_lock);
 	struct file *open_file = filesys_open(file_open_name);
 
 	if(open_file == NULL){
@@ -251,7 +244,6 @@ int sc_open(struct intr_frame *f){
 			
 		}
 	}
-	lock_release(&filesys_lock);
 
 	return fd;
 }
@@ -263,9 +255,7 @@ int sc_filesize(struct intr_frame *f){
 	fd_check(fd);
 	struct file *cur_file = get_file(fd);
 
-	lock_acquire(&filesys_lock);
 	int success = file_length(cur_file);
-	lock_release(&filesys_lock);
 	return success;
 }
 
@@ -291,9 +281,7 @@ int sc_read(struct intr_frame *f){
 			exit(-1);
 		}
 		#endif
-		lock_acquire(&filesys_lock);
 		real_read = (int)file_read(cur_file,buffer,size);
-		lock_release(&filesys_lock);
 	}
 	
 	return real_read;
@@ -316,9 +304,7 @@ int sc_write(struct intr_frame *f){
 		real_write = (int)size;
 	}else{
 		struct file *cur_file = get_file(fd);
-		lock_acquire(&filesys_lock);
 		real_write = (int)file_write(cur_file,buffer,size);
-		lock_release(&filesys_lock);
 	}
 	return real_write;
 }
@@ -330,9 +316,7 @@ void sc_seek(struct intr_frame *f){
 
 	fd_check(fd);
 	struct file *cur_file = get_file(fd);
-	lock_acquire(&filesys_lock);
 	file_seek(cur_file,position);
-	lock_release(&filesys_lock);
 }
 
 static
@@ -341,9 +325,7 @@ unsigned sc_tell(struct intr_frame *f){
 
 	fd_check(fd);
 	struct file *cur_file = get_file(fd);
-	lock_acquire(&filesys_lock);
 	unsigned success = (unsigned)file_tell(cur_file);
-	lock_release(&filesys_lock);
 	return success;
 }
 
@@ -353,10 +335,8 @@ void sc_close(struct intr_frame *f){
 	
 	fd_check(fd);
 	struct file *cur_file = get_file(fd);
-	lock_acquire(&filesys_lock);
 	cur_file = NULL;
 	file_close(cur_file);
-	lock_release(&filesys_lock);
 }
 #ifdef VM
 
@@ -371,13 +351,10 @@ void *sc_mmap(struct intr_frame *f){
 
 	struct file *cur_file = get_file(fd);
 	/* 실패 할때 NULL 반환 */
-	lock_acquire(&filesys_lock);
 	// fd로 열린 파일의 길이가 0 바이트 면 호출 실패 or length 이 0 일때도 실패
 	if(file_length(cur_file) <= 0  || (int)length <= 0){
-		lock_release(&filesys_lock);
 		return succ;
 	}
-	lock_release(&filesys_lock);
 	//addr 이 NULL 인 경우 실패 or addr이 페이지 정렬 안되면 실패  
 	if(addr == NULL || ((uint64_t)addr % PGSIZE)){
 		return succ;
@@ -11,6 +11,9 @@
 
 
 struct bitmap *swap_bitmap;
+/* swap_bitmap 을 보호한다. 폴트를 처리하는 스레드와 kswapd 가
+   동시에 슬롯을 잡거나 놓을 수 있다. 디스크 I/O 중에는 잡지 않는다. */
+static struct lock swap_lock;
 size_t swap_slots;
 disk_sector_t sectors;
 
@@ -40,6 +43,7 @@ vm_anon_init (void) {
 	// disk_get(chan_no, dev_no) chan_no = 채널 넘버,장치 넘버
 	// 페이지 사이즈: 4KB, 섹터 사이즈: 512 B: 8 개의 섹터 = 1 Swap slot
     // 따라서 스왑 디스크의 섹터 개수 / 8 = Swap slot 개수
+    lock_init(&swap_lock);
     swap_disk = disk_get(1, 1);
     sectors = disk_size(swap_disk) / SLOT;
  	swap_bitmap = bitmap_create(sectors);
@@ -75,17 +79,41 @@ static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
 	size_t offset = anon_page->offset;
+    bool in_swap;
 
-    if (bitmap_test(swap_bitmap, offset) == 0)
+    lock_acquire(&swap_lock);
+    in_swap = offset != (size_t) -1 && bitmap_test(swap_bitmap, offset);
+    lock_release(&swap_lock);
+    if (!in_swap)
     {
         PANIC("스왑디스크에 없음. 따라서 swap in 못함!");
     }
 
-    for (int i = 0; i < SLOT; ++i)
-    {
-        disk_read(swap_disk, offset * SLOT + i, kva + (i * DISK_SECTOR_SIZE));
-    }
-    bitmap_flip(swap_bitmap, offset);
+    // 한 번의 명령으로 슬롯 전체(8 섹터)를 읽음
+    // 다 읽은 뒤에 슬롯을 놓아야 다른 페이지가 덮어쓰지 못한다.
+    disk_read_multi(swap_disk, offset * SLOT, SLOT, kva);
+    lock_acquire(&swap_lock);
+    bitmap_reset(swap_bitmap, offset);
+    lock_release(&swap_lock);
+    // 놓은 슬롯을 anon_destroy 가 다시 놓지 않도록 지운다.
+    anon_page->offset = -1;
+    return true;
+}
+
+/* SRC 의 스왑 슬롯 내용을 KVA 로 읽어온다. 슬롯은 계속 SRC 의 것이다.
+ * fork 시 스왑 아웃되어 있던 부모 페이지를 자식에게 복사할 때 쓴다. */
+bool
+anon_swap_copy (struct page *src, void *kva) {
+	size_t offset = src->anon.offset;
+    bool in_swap;
+
+    lock_acquire(&swap_lock);
+    in_swap = offset != (size_t) -1 && bitmap_test(swap_bitmap, offset);
+    lock_release(&swap_lock);
+    if (!in_swap)
+        return false;
+
+    disk_read_multi(swap_disk, offset * SLOT, SLOT, kva);
     return true;
 }
 
@@ -101,24 +129,29 @@ anon_swap_in (struct page *page, void *kva) {
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
-    uint64_t *pml4 = thread_current()->pml4;
+    // 다른 프로세스의 프레임을 내보낼 수도 있으므로 페이지 주인의 pml4 를 쓴다.
+    uint64_t *pml4 = page->owner->pml4;
     void *buff = page->frame->kva;
     size_t offset;
 
-    if ((offset = bitmap_scan_and_flip(swap_bitmap, 0, 1, 0)) == BITMAP_ERROR)
+    /* 주인 프로세스는 계속 실행 중일 수 있으므로 먼저 매핑을 지운다.
+       그래야 디스크에 쓰는 동안 바뀐 내용을 잃지 않는다.
+       그 사이에 난 폴트는 page->frame 이 NULL 이 될 때까지 기다린다. */
+    pml4_clear_page(pml4, page->va);
+
+    lock_acquire(&swap_lock);
+    offset = bitmap_scan_and_flip(swap_bitmap, 0, 1, 0);
+    lock_release(&swap_lock);
+    if (offset == BITMAP_ERROR)
     {
         PANIC("bitmap error");
     }
 
-    // 512 바이트 단위로 끊어서 작성? 8 번
-    for (int i = 0; i < SLOT; ++i)
-    {
-        disk_write(swap_disk, offset * SLOT + i, buff + (i * DISK_SECTOR_SIZE));
-    }
+    // 한 번의 명령으로 슬롯 전체(8 섹터)를 기록
+    disk_write_multi(swap_disk, offset * SLOT, SLOT, buff);
 
     anon_page->offset = offset;
     page->frame = NULL;
-    pml4_clear_page(pml4, page->va);
 	return true;
 }
 
@@ -127,13 +160,25 @@ anon_swap_out (struct page *page) {
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
-	struct frame *frame = page->frame;
+    // 다른 스레드가 내보내는 중이면 스왑 슬롯에 다 쓸 때까지 기다린다.
+	struct frame *frame = vm_frame_pin(page);
 	 if (frame != NULL) // frame 해제
     {
-        vm_free_frame(frame);
+        // 다른 프로세스가 아직 공유 중인 프레임은 pml4_destroy 가
+        // 해제하지 않도록 매핑만 지운다. 마지막이면 여기서 해제한다.
+        pml4_clear_page(thread_current()->pml4, page->va);
+        if (vm_frame_unshare(page))
+            vm_frame_unpin(frame);
+        else
+        {
+            palloc_free_page(frame->kva);
+            vm_free_frame(frame);
+        }
     }
 
     if (anon_page->offset != -1){
+        lock_acquire(&swap_lock);
         bitmap_set(swap_bitmap, anon_page->offset, 0);
+        lock_release(&swap_lock);
     }
 }
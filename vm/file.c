@@ -47,13 +47,10 @@ file_backed_swap_in (struct page *page, void *kva) {
     size_t page_zero_bytes = file_page->zero_bytes;
 
 	// 파일의 내용을 페이지에 입력한다
-	lock_acquire(&filesys_lock);
 	if(file_read_at(file_page->file, kva, page_read_bytes, file_page->offset) != (int)page_read_bytes){
 		// 제대로 입력이 안되면  false 반환
-		lock_release(&filesys_lock);
 		return false;
 	}
-	lock_release(&filesys_lock);
 	// 나머지 부분을 0으로 입력
 	memset(kva + page_read_bytes, 0, page_zero_bytes);
 	return true;
@@ -67,23 +64,27 @@ file_backed_swap_in (struct page *page, void *kva) {
 static bool
 file_backed_swap_out (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
+	// 다른 프로세스의 페이지일 수 있으므로 주인의 pml4 와 커널 주소를 쓴다.
+	uint64_t *pml4 = page->owner->pml4;
+
+	/* 사용자 가상 페이지 UPAGE를 페이지 디렉토리 PD에서 "프레젠트되지 않음"으로 표시합니다.
+	이후에 페이지에 접근하면 페이지 폴트가 발생합니다.
+	페이지 테이블 항목의 다른 비트는 보존됩니다.
+	UPAGE는 매핑되어 있지 않아도 됩니다. */
+	/* 주인 프로세스가 파일에 쓰는 동안 바꾼 내용을 잃지 않도록
+	   매핑을 먼저 지우고 나서 더티 비트를 본다. (더티 비트는 남아 있다) */
+	pml4_clear_page(pml4, page->va);
+
 	/* PML4의 가상 페이지 VPAGE에 대한 PTE가 변경되었는지 확인하여, 
 	변경되었다면 true를 반환합니다.
 	만약 PML4에 VPAGE에 대한 PTE가 없다면 false를 반환합니다. */
-	if (pml4_is_dirty(thread_current()->pml4, page->va))
+	if (pml4_is_dirty(pml4, page->va))
 	{
-		lock_acquire(&filesys_lock);
-		file_write_at(file_page->file, page->va, file_page->read_bytes, file_page->offset);
-		lock_release(&filesys_lock);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
+		file_write_at(file_page->file, page->frame->kva, file_page->read_bytes, file_page->offset);
+		pml4_set_dirty(pml4, page->va, 0);
 	}
-	/* 사용자 가상 페이지 UPAGE를 페이지 디렉토리 PD에서 "프레젠트되지 않음"으로 표시합니다.
-	이후에 페이지에 접근하면 페이지 폴트가 발생합니다.
-	페이지 테이블 항목의 다른 비트는 보존됩니다.
-	UPAGE는 매핑되어 있지 않아도 됩니다. */
 	page->frame->page = NULL;
 	page->frame = NULL;
-	pml4_clear_page(thread_current()->pml4, page->va);
 
 	return true;
 }
@@ -95,14 +96,26 @@ file_backed_destroy (struct page *page) {
 	
 	// page struct를 해제할 필요는 없습니다. (file_backed_destroy의 호출자가 해야 함)
 	struct file_page *file_page UNUSED = &page->file;
-	if (pml4_is_dirty(thread_current()->pml4, page->va))
+	uint64_t *pml4 = thread_current()->pml4;
+	/* 다른 스레드가 내보내는 중이면 파일에 다 쓸 때까지 기다린다. */
+	struct frame *frame = vm_frame_pin(page);
+
+	/* 메모리에 올라와 있지 않으면 쓸 내용도, 놓을 프레임도 없다.
+	   munmap 으로 이미 파괴된 페이지도 여기서 걸러진다. */
+	if (frame == NULL)
+		return;
+
+	if (pml4_is_dirty(pml4, page->va))
 	{
-		lock_acquire(&filesys_lock);
-		file_write_at(file_page->file, page->va, file_page->read_bytes, file_page->offset);
-		lock_release(&filesys_lock);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
+		file_write_at(file_page->file, frame->kva, file_page->read_bytes, file_page->offset);
+		pml4_set_dirty(pml4, page->va, 0);
 	}
-	pml4_clear_page(thread_current()->pml4, page->va);
+	/* 매핑을 지웠으므로 pml4_destroy 가 대신 해제해 주지 않는다.
+	   프레임 테이블에서도 빼서 clock 이 해제된 페이지를 보지 않게 한다. */
+	pml4_clear_page(pml4, page->va);
+	vm_frame_unshare(page);
+	palloc_free_page(frame->kva);
+	vm_free_frame(frame);
 
 }
 
@@ -201,13 +214,10 @@ load_file (struct page *page, void *aux) {
 
 	void *kpage = page->frame->kva;
 
-	lock_acquire(&filesys_lock);
 	if(file_read_at(fp->file, kpage, fp->read_bytes, fp->offset) != (int)(fp->read_bytes)){
-		lock_release(&filesys_lock);
 		palloc_free_page(kpage);
 		return false;
 	}
-	lock_release(&filesys_lock);
 	
 	memset(kpage + fp->read_bytes, 0, fp->zero_bytes);
 	free(fp);
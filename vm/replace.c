@@ -0,0 +1,193 @@
+/* replace.c: Page replacement policies. */
+/* replace.c: 페이지 교체 정책들의 구현입니다.
+ * 프레임 테이블(frame_list)과 frame_lock 은 vm.c 가 가지고 있고,
+ * 여기서는 그 리스트에서 내보낼 프레임을 고르기만 한다. */
+
+#include <string.h>
+#include "vm/vm.h"
+#include "vm/replace.h"
+#include "devices/timer.h"
+#include "threads/mmu.h"
+
+static struct list *frames;
+/* frames 의 원소 개수. list_size 는 리스트를 다 세므로 vm.c 가 세어 둔다. */
+static size_t *frame_cnt;
+/* clock, WSClock 이 쓰는 시계 바늘. 호출 사이에도 위치를 유지한다. */
+static struct list_elem *clock_hand;
+
+static struct frame *clock_select (void);
+static struct frame *wsclock_select (void);
+static struct frame *lruk_select (void);
+static void clock_remove (struct frame *frame);
+
+static const struct replace_policy clock_policy = {
+	.name = "clock",
+	.select = clock_select,
+	.remove = clock_remove,
+};
+
+static const struct replace_policy wsclock_policy = {
+	.name = "wsclock",
+	.select = wsclock_select,
+	.remove = clock_remove,
+};
+
+static const struct replace_policy lruk_policy = {
+	.name = "lru-k",
+	.select = lruk_select,
+	.remove = clock_remove,
+};
+
+static const struct replace_policy *policies[] = {
+	&clock_policy, &wsclock_policy, &lruk_policy, NULL,
+};
+
+/* 현재 쓰고 있는 교체 정책. 기본은 clock. */
+const struct replace_policy *replace_policy = &clock_policy;
+
+/* 이름이 NAME 인 정책을 고른다. 그런 정책이 없으면 false. */
+bool
+replace_set_policy (const char *name) {
+	const struct replace_policy **p;
+
+	for (p = policies; *p != NULL; p++)
+		if (!strcmp ((*p)->name, name)) {
+			replace_policy = *p;
+			return true;
+		}
+	return false;
+}
+
+/* FRAMES 를 프레임 테이블로 삼아 정책을 초기화한다.
+ * *CNT 는 FRAMES 의 원소 개수로, 호출자가 frame_lock 아래에서 맞춰 둔다. */
+void
+replace_init (struct list *frame_list, size_t *cnt) {
+	frames = frame_list;
+	frame_cnt = cnt;
+	clock_hand = NULL;
+}
+
+/* FRAME 이 NOW 에 참조되었음을 기록한다. 참조 기록을 한 칸씩 민다. */
+void
+replace_touch (struct frame *frame, int64_t now) {
+	int i;
+
+	for (i = LRU_K - 1; i > 0; i--)
+		frame->ref_hist[i] = frame->ref_hist[i - 1];
+	frame->ref_hist[0] = now;
+}
+
+/* 내보낼 수 있는 프레임인가?
+ * 아직 페이지와 연결되지 않았거나 다른 스레드가 내보내는 중인 프레임,
+ * 여러 프로세스가 공유 중인 프레임, 주인이 종료 중인 프레임은 제외한다. */
+static bool
+evictable (struct frame *f) {
+	return f->page != NULL && !f->pinned && f->share_cnt <= 1
+		&& f->owner->pml4 != NULL;
+}
+
+/* F 의 접근 비트를 읽고 지운다. 접근되었으면 참조 기록도 남긴다. */
+static bool
+test_and_clear_accessed (struct frame *f, int64_t now) {
+	uint64_t *pml4 = f->owner->pml4;
+
+	if (!pml4_is_accessed (pml4, f->page->va))
+		return false;
+	pml4_set_accessed (pml4, f->page->va, 0);
+	replace_touch (f, now);
+	return true;
+}
+
+/* 시계 바늘을 한 칸 옮기고 바늘이 가리키던 프레임을 반환한다.
+ * 리스트 끝에 닿으면 처음으로 돌아간다. */
+static struct frame *
+clock_advance (void) {
+	struct list_elem *e = clock_hand;
+
+	if (list_empty (frames))
+		return NULL;
+	if (e == NULL || e == list_end (frames))
+		e = list_begin (frames);
+	clock_hand = list_next (e);
+	return list_entry (e, struct frame, elem);
+}
+
+/* 시계 바늘이 가리키던 프레임이 빠지면 다음 프레임으로 옮긴다. */
+static void
+clock_remove (struct frame *frame) {
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+}
+
+/* second chance clock: 바늘이 지나가며 접근 비트를 지우고,
+ * 한 바퀴 동안 다시 접근되지 않은 프레임을 고른다.
+ * 접근 비트는 프레임을 가진 프로세스의 pml4 에서 본다. */
+static struct frame *
+clock_select (void) {
+	int64_t now = timer_ticks ();
+	size_t i, n = 2 * *frame_cnt;
+
+	for (i = 0; i < n; i++) {
+		struct frame *f = clock_advance ();
+
+		if (!evictable (f) || test_and_clear_accessed (f, now))
+			continue;
+		return f;
+	}
+	return NULL;
+}
+
+/* WSClock: clock 처럼 돌되, 마지막 참조가 WSCLOCK_TAU 틱보다 오래된
+ * (작업 집합 밖의) 프레임만 고르고, 그 중에서도 쓰기가 필요 없는
+ * 깨끗한 프레임을 먼저 고른다. 깨끗한 프레임이 없으면 처음 본
+ * 작업 집합 밖의 더러운 프레임을, 그것도 없으면 가장 오래된 프레임을
+ * 고른다. */
+static struct frame *
+wsclock_select (void) {
+	int64_t now = timer_ticks ();
+	size_t i, n = 2 * *frame_cnt;
+	struct frame *dirty = NULL;
+	struct frame *oldest = NULL;
+
+	for (i = 0; i < n; i++) {
+		struct frame *f = clock_advance ();
+
+		if (!evictable (f) || test_and_clear_accessed (f, now))
+			continue;
+		if (oldest == NULL || f->ref_hist[0] < oldest->ref_hist[0])
+			oldest = f;
+		if (now - f->ref_hist[0] <= WSCLOCK_TAU)
+			continue;
+		if (!pml4_is_dirty (f->owner->pml4, f->page->va))
+			return f;
+		if (dirty == NULL)
+			dirty = f;
+	}
+	return dirty != NULL ? dirty : oldest;
+}
+
+/* LRU-K 근사: 접근 비트로 표본을 뜬 최근 LRU_K 번의 참조 시각 중
+ * 가장 오래된 것(backward K-distance)이 가장 먼 프레임을 고른다.
+ * 참조가 K 번 미만인 프레임은 무한히 먼 것으로 보고 먼저 고르며,
+ * 같으면 마지막 참조가 오래된 프레임을 고른다.
+ * 표본은 교체할 때만 뜨므로 그 사이의 여러 참조는 한 번으로 센다. */
+static struct frame *
+lruk_select (void) {
+	int64_t now = timer_ticks ();
+	struct frame *victim = NULL;
+	struct list_elem *e;
+
+	for (e = list_begin (frames); e != list_end (frames); e = list_next (e)) {
+		struct frame *f = list_entry (e, struct frame, elem);
+
+		if (!evictable (f))
+			continue;
+		test_and_clear_accessed (f, now);
+		if (victim == NULL
+				|| f->ref_hist[LRU_K - 1] < victim->ref_hist[LRU_K - 1]
+				|| (f->ref_hist[LRU_K - 1] == victim->ref_hist[LRU_K - 1]
+					&& f->ref_hist[0] < victim->ref_hist[0]))
+			victim = f;
+	}
+	return victim;
+}
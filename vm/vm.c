@@ -1,17 +1,49 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <stdio.h>
 #include "threads/malloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 #include "include/threads/vaddr.h"
 #include "include/threads/mmu.h"
+#include "filesys/inode.h"
+#include "devices/timer.h"
 
 static struct list frame_list;
+static size_t frame_cnt;                /* frame_list 의 원소 개수. */
 static struct lock frame_lock;
+/* 프레임의 pinned 가 풀리거나 프레임이 해제되는 등 내보낼 수 있는 프레임이
+   생길 수 있을 때마다 알린다. frame_lock 과 함께 쓴다. */
+static struct condition evict_cond;
+
+/* Statistics. */
+static long long fault_cnt;             /* 처리한 페이지 폴트. */
+static long long evict_cnt;             /* 내보낸 프레임. */
+static long long writeback_cnt;         /* 내보낼 때 디스크에 쓴 프레임. */
+static long long refault_cnt;           /* 내보냈던 페이지를 다시 읽어 온 횟수. */
+static long long kswapd_cnt;            /* 그 중 kswapd 가 내보낸 프레임. */
+
+/* kswapd: 사용자 풀의 빈 페이지가 kswapd_low 아래로 내려가면 깨어나
+   kswapd_high 가 될 때까지 차가운 프레임을 미리 내보낸다.
+   그러면 대부분의 폴트는 내보내기를 기다리지 않고 빈 프레임을 얻는다. */
+static size_t kswapd_low;
+static size_t kswapd_high;
+static struct semaphore kswapd_sema;
+static bool kswapd_running;
+
+static void kswapd (void *aux);
+static void kswapd_wakeup (void);
+
+/* 읽기 전용 실행 파일 페이지를 담은 프레임을 (inode, offset) 으로 찾는 테이블.
+   같은 프로그램을 여러 번 실행해도 코드 페이지는 한 번만 읽는다.
+   frame_lock 으로 보호한다. */
+static struct hash shared_frames;
 
 static uint64_t page_hash_func(const struct hash_elem *,void *);
 static bool page_less_func(const struct hash_elem *, const struct hash_elem *,void *);
 static void hash_destroy_func (struct hash_elem *, void *);
+static uint64_t shared_hash_func(const struct hash_elem *,void *);
+static bool shared_less_func(const struct hash_elem *, const struct hash_elem *,void *);
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -25,7 +57,20 @@ vm_init (void) {
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
 	list_init(&frame_list); // 프레임을 관리할 list (전역 선언 되어있음)
+	frame_cnt = 0;
+	replace_init(&frame_list, &frame_cnt);
 	lock_init(&frame_lock); // 프레임 동기화를 위한 lock (전역 선언 되어있음)
+	cond_init(&evict_cond);
+	hash_init(&shared_frames,shared_hash_func,shared_less_func,NULL);
+
+	/* 워터마크는 부팅 시 사용자 풀 크기에 비례한다.
+	   풀이 아주 작으면 0 이 되어 kswapd 는 일하지 않는다. */
+	kswapd_low = palloc_free_cnt(PAL_USER) / 32;
+	kswapd_high = kswapd_low * 2;
+	sema_init(&kswapd_sema, 0);
+	kswapd_running = false;
+	if(thread_create("kswapd", PRI_DEFAULT, kswapd, NULL) == TID_ERROR)
+		PANIC("could not start kswapd");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -46,9 +91,16 @@ page_get_type (struct page *page) {
 }
 
 /* Helpers */
-static struct frame *vm_get_victim (void);
+static struct frame *vm_get_victim (bool wait);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static void vm_frame_link (struct frame *frame, struct page *page);
+static void frame_link_locked (struct frame *frame, struct page *page);
+static void shared_frame_remove (struct frame *frame);
+static void frame_wait_locked (struct page *page);
+static void frame_reset (struct frame *frame);
+static bool vm_claim_shared (struct page *page, disk_sector_t inumber,
+		off_t offset, size_t read_bytes);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -88,6 +140,7 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		uninit_new(newpage,upage,init,type,aux,page_init);
 		// 페이지 속성에 맞게 수정
 		newpage->writable = writable;
+		newpage->owner = thread_current();
 		// 보조 페이지 테이블에 페이지 입력
 	 	return spt_insert_page(spt,newpage);
 	}
@@ -106,7 +159,7 @@ spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
 	struct page tp;
 	// 새로운 페이지에 찾을 페이지 주소로 변경
 	tp.va = pg_round_down(va);
-	lock_acquire(&spt->page_lock);
+	rwlock_acquire_read(&spt->page_lock);
 	// 보조 페이지 테이블에 찾는 페이지가
 	// 있다면 hash_elem 값 반환 없다면 NULL 반환
 	e = hash_find(&spt->pages,&tp.elem);
@@ -115,7 +168,7 @@ spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
 		//hash_elem 값이 있다면 페이지로 만들어서 전달
 		page = hash_entry(e ,struct page, elem);
 	}
-	lock_release(&spt->page_lock);
+	rwlock_release_read(&spt->page_lock);
 	return page;
 }
 
@@ -130,11 +183,11 @@ spt_insert_page (struct supplemental_page_table *spt UNUSED,
 		return succ;
 	}
 	// spt 에 페이지를 입력한다.
-	lock_acquire(&spt->page_lock);
+	rwlock_acquire_write(&spt->page_lock);
 	if(hash_insert(&spt->pages,&page->elem)==NULL){
 		succ = true;
 	}
-	lock_release(&spt->page_lock);
+	rwlock_release_write(&spt->page_lock);
 	return succ;
 }
 
@@ -147,41 +200,51 @@ spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
 
 /* Get the struct frame, that will be evicted. */
 /* 죽을 때 제거될 구조체 프레임을 가져옵니다. */
+/* 어떤 프레임을 고를지는 replace_policy 가 정한다.
+ * 고를 수 있는 프레임이 없으면 NULL 을 반환한다.
+ * WAIT 이면 프레임이 풀리거나 해제될 때까지 기다리며, 그 사이 사용자 풀에
+ * 빈 페이지가 생겨서 멈춘 경우에만 NULL 을 반환한다. */
 static struct frame *
-vm_get_victim (void) {
-	struct frame *victim = NULL;
-	/* TODO: The policy for eviction is up to you. */
-	/* TODO: 제거 정책은 여러분에게 달려 있습니다. */
-	/* victim = list_entry(list_pop_front(&frame_list),struct frame, elem); */
-	struct list_elem *e;
+vm_get_victim (bool wait) {
+	struct frame *victim;
+
 	// 프레임 교체시 동기화를 하기위한 락
 	lock_acquire(&frame_lock);
-	// 프레임이 담겨있는 리스트에 처음부터 마지막 까지 비교
-	for(e = list_begin(&frame_list); e != list_end(&frame_list); e = list_next(e)){
-		// 하나의 페이지를 꺼낸다.
-		victim = list_entry(e,struct frame,elem);
-		uint64_t *pml4 = thread_current()->pml4;
-
-		if(victim->page == NULL){
-			break;
-		}
-		/* 
-		그 페이지에 접근했는지 확인한다. 
-		PTE가 설치된 시간과 마지막으로 지워진 시간 사이에 접근된 경우			
-		(최근에 접근한 경우 True, pte가 없는 경우 false)
-			*/
-		else if(pml4_is_accessed(pml4,victim->page->va)){
-				// 최근에 접근 했다면 false 로 바꾸고 다음 페이지로 변경
-				pml4_set_accessed(pml4,victim->page->va,0);
-		}else{
-				// false 이 뜨면 희생 페이지로 함수를 반환한다.
-			break;
-		}
+	while((victim = replace_policy->select()) == NULL
+			&& wait && palloc_free_cnt(PAL_USER) == 0){
+		cond_wait(&evict_cond, &frame_lock);
+	}
+	// 내보낼 프레임은 더 이상 다른 프로세스가 찾아 쓰지 못하게 한다.
+	if(victim != NULL){
+		victim->pinned = true;
+		shared_frame_remove(victim);
 	}
 	lock_release(&frame_lock);
 	return victim;
 }
 
+/* VICTIM 에 있는 페이지를 내보낸다. */
+static void
+frame_evict_page (struct frame *victim) {
+	if (victim->page != NULL){
+		// 어디로 가는걸까?
+		/*
+		anon or file 타입의 페이지가 물리 메모리를 할당받고 있으니 
+		둘의 swap out에 가는게 아닐까?
+		*/		
+		struct page *page = victim->page;
+
+		/* anon 페이지는 항상 스왑 디스크에 쓰고,
+		   file 페이지는 더러울 때만 파일에 쓴다. */
+		evict_cnt++;
+		if(VM_TYPE(page->operations->type) == VM_ANON
+				|| pml4_is_dirty(victim->owner->pml4, page->va)){
+			writeback_cnt++;
+		}
+        swap_out(page);
+	}
+}
+
 /* Evict one page and return the corresponding frame.
  * Return NULL on error.*/
 /* 페이지를 하나 대체하고 해당하는 프레임을 반환합니다.
@@ -189,22 +252,68 @@ vm_get_victim (void) {
 static struct frame *
 vm_evict_frame (void) {
 	// 희생 페이지가 정해지면
-	struct frame *victim = vm_get_victim ();
+	// 모든 프레임이 사용 중이면 다른 스레드가 프레임을 놓을 때까지 잠든다.
+	struct frame *victim = vm_get_victim (true);
+
+	if(victim == NULL){
+		return NULL;
+	}
 	/* TODO: swap out the victim and return the evicted frame. */
 	/* TODO: 희생자를 교체하고 제거된 프레임을 반환합니다. */
-	if (victim->page != NULL){
-		// 어디로 가는걸까?
-		/*
-		anon or file 타입의 페이지가 물리 메모리를 할당받고 있으니 
-		둘의 swap out에 가는게 아닐까?
-		*/		
-        swap_out(victim->page);
-	}
+	frame_evict_page(victim);
+	// 페이지와의 연결을 끊고 나서 기다리던 스레드들을 깨운다.
+	lock_acquire(&frame_lock);
+	frame_reset(victim);
+	cond_broadcast(&evict_cond, &frame_lock);
+	lock_release(&frame_lock);
 	//깨끗한 페이지를 반환해준다.
 	return victim;
 	
 }
 
+/* kswapd 를 깨운다. 이미 일하는 중이면 아무것도 하지 않는다. */
+static void
+kswapd_wakeup (void) {
+	if(!kswapd_running){
+		kswapd_running = true;
+		sema_up(&kswapd_sema);
+	}
+}
+
+/* 백그라운드 페이지 내보내기 스레드.
+ * 내보낸 프레임은 사용자 풀로 돌려주어 다음 폴트가 바로 쓰게 한다. */
+static void
+kswapd (void *aux UNUSED) {
+	for(;;){
+		sema_down(&kswapd_sema);
+		while(palloc_free_cnt(PAL_USER) < kswapd_high){
+			struct frame *victim = vm_get_victim(false);
+
+			if(victim == NULL){
+				break;
+			}
+			frame_evict_page(victim);
+			kswapd_cnt++;
+			palloc_free_page(victim->kva);
+			vm_free_frame(victim);
+		}
+		kswapd_running = false;
+	}
+}
+
+/* 새로 얻었거나 내보낸 프레임을 아무 페이지도 없는 상태로 만든다.
+ * 방금 폴트가 난 페이지가 들어올 것이므로 지금 참조된 것으로 기록한다. */
+static void
+frame_reset (struct frame *frame) {
+	frame->page = NULL;
+	frame->owner = NULL;
+	list_init(&frame->sharers);
+	frame->share_cnt = 0;
+	memset(frame->ref_hist, 0, sizeof frame->ref_hist);
+	frame->ref_hist[0] = timer_ticks();
+	frame->pinned = false;
+}
+
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
@@ -218,23 +327,36 @@ static struct frame *
 vm_get_frame (void) {
 	struct frame *frame = NULL;
 	/* TODO: Fill this function. */
-	// 페이지 하나를 할당한다.
-	void *kva = palloc_get_page(PAL_USER | PAL_ZERO);
-	// 만약 페이지가 할당이 안됬다면 페이지가 꽉찼다는 말과 같으니까
-	if(kva == NULL){
+	void *kva;
+
+	for(;;){
+		// 페이지 하나를 할당한다.
+		kva = palloc_get_page(PAL_USER | PAL_ZERO);
+		// 빈 페이지가 낮은 워터마크 아래로 내려가면 kswapd 를 깨운다.
+		if(palloc_free_cnt(PAL_USER) < kswapd_low){
+			kswapd_wakeup();
+		}
+		if(kva != NULL){
+			break;
+		}
+		// 만약 페이지가 할당이 안됬다면 페이지가 꽉찼다는 말과 같으니까
 		// 프레임 중에 하나 선택해서 페이지 맵핑을 초기화 하고 그 프레임을 반환한다. 
+		// 기다리는 동안 다른 스레드가 페이지를 놓았다면 다시 할당해 본다.
 		frame = vm_evict_frame();
-		memset(frame->kva, 0, PGSIZE);
-		frame->page = NULL;
-		return frame;
+		if(frame != NULL){
+			memset(frame->kva, 0, PGSIZE);
+			return frame;
+		}
 	}
 	//프레임 페이지 할당이 되었다면 프레임을 할당한다.
 	frame = (struct frame *)malloc(sizeof(struct frame));
 	frame->kva = kva;
-	frame->page = NULL;
+	frame->shared = false;
+	frame_reset(frame);
 	//프레임들을 관리하기위에 리스트에넣는다
 	lock_acquire(&frame_lock);
 	list_push_back(&frame_list,&frame->elem);
+	frame_cnt++;
 	lock_release(&frame_lock);
 
 	ASSERT(frame != NULL);
@@ -252,9 +374,44 @@ vm_stack_growth (void *addr UNUSED) {
 
 /* Handle the fault on write_protected page */
 /* 쓰기 보호된 페이지에서 발생한 오류를 처리합니다. */
+/* fork 이후 부모와 자식이 함께 쓰던 프레임에 처음 쓰기를 하면
+ * 그 때 프레임을 복사한다. 마지막으로 남은 페이지라면 복사 없이
+ * 쓰기 권한만 되돌린다. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	uint64_t *pml4 = thread_current()->pml4;
+	struct frame *old = vm_frame_pin(page);
+	struct frame *frame;
+	bool success;
+
+	// 그 사이 내보내졌다면 다시 폴트가 나서 스왑에서 읽어 온다.
+	if(old == NULL){
+		return true;
+	}
+	if(old->share_cnt == 1){
+		pml4_clear_page(pml4, page->va);
+		success = pml4_set_page(pml4, page->va, old->kva, true);
+		vm_frame_unpin(old);
+		return success;
+	}
+
+	/* old 를 고정해 두었으므로 복사하는 동안 내보내지지 않는다. */
+	frame = vm_get_frame();
+	memcpy(frame->kva, old->kva, PGSIZE);
+
+	pml4_clear_page(pml4, page->va);
+	/* 복사하는 동안 다른 공유자가 모두 종료했다면 old 를 놓는 것은
+	   우리가 마지막이다. 매핑을 지웠으므로 pml4_destroy 가 대신
+	   해제해 주지 않으니 여기서 해제한다. */
+	if(vm_frame_unshare(page)){
+		vm_frame_unpin(old);
+	}else{
+		palloc_free_page(old->kva);
+		vm_free_frame(old);
+	}
+	vm_frame_link(frame, page);
 
+	return pml4_set_page(pml4, page->va, frame->kva, true);
 }
 
 /* Return true on success */
@@ -273,9 +430,20 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	// 유효성 검사
 	/* addr = Fault address. */
 	/* not_present == True: not-present page, false: writing r/o page. */
-	if(addr == NULL || is_kernel_vaddr(addr) || !not_present){
+	if(addr == NULL || is_kernel_vaddr(addr)){
 		return success;
 	}
+	fault_cnt++;
+
+	/* 매핑은 되어 있는데 읽기 전용인 페이지에 쓴 경우:
+	   원래 쓰기 가능한 페이지라면 copy-on-write 로 공유 중인 프레임이다. */
+	if(!not_present){
+		page = spt_find_page(spt,addr);
+		if(page == NULL || !write || !page->writable || page->frame == NULL){
+			return success;
+		}
+		return vm_handle_wp(page);
+	}
 	
 	void *rsp = f->rsp;
 	/* user == True: access by user, false: access by kernel. */
@@ -300,6 +468,12 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	if(page == NULL){
 		return success;
 	}
+	/* 다른 스레드(kswapd 등)가 이 페이지를 내보내는 중이면
+	   디스크에 다 쓸 때까지 잠들어 있다가 다시 읽어 온다.
+	   양보하며 돌면 kswapd 보다 우선순위가 높은 스레드는 끝나지 않는다. */
+	lock_acquire(&frame_lock);
+	frame_wait_locked(page);
+	lock_release(&frame_lock);
 	// write 불가능 페이지인데 요청 한 경우
 	if(write == true && page->writable == false){
 		return success;
@@ -340,11 +514,35 @@ vm_claim_page (void *va UNUSED) {
 /* 페이지를 차지하고 MMU를 설정합니다. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	struct frame *frame;
+	bool shareable = false;
+	disk_sector_t inumber = 0;
+	off_t offset = 0;
+	size_t read_bytes = 0;
+
+	/* 읽기 전용 실행 파일 페이지(VM_MARKER_1)는 다른 프로세스가
+	   이미 읽어 둔 프레임이 있으면 그것을 함께 쓴다. */
+	if(VM_TYPE(page->operations->type) == VM_UNINIT
+			&& (page->uninit.type & VM_MARKER_1) && !page->writable){
+		struct file_page *fp = page->uninit.aux;
+		shareable = true;
+		inumber = inode_get_inumber(file_get_inode(fp->file));
+		offset = fp->offset;
+		read_bytes = fp->read_bytes;
+		if(vm_claim_shared(page, inumber, offset, read_bytes)){
+			return true;
+		}
+	}
+
+	/* 이미 초기화된 페이지에 프레임이 없다면 내보내졌던 페이지이다. */
+	if(VM_TYPE(page->operations->type) != VM_UNINIT){
+		refault_cnt++;
+	}
+
+	frame = vm_get_frame ();
 
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	vm_frame_link(frame, page);
 
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
 	/* TODO: 페이지 테이블 엔트리를 삽입하여 
@@ -358,14 +556,66 @@ vm_do_claim_page (struct page *page) {
 		}
 	}
 
-	return swap_in (page, frame->kva); // uninit_initialize
+	if(!swap_in (page, frame->kva)){ // uninit_initialize
+		return false;
+	}
+
+	// 처음 읽어 온 공유 가능 페이지는 테이블에 등록한다.
+	if(shareable){
+		lock_acquire(&frame_lock);
+		frame->inumber = inumber;
+		frame->offset = offset;
+		frame->read_bytes = read_bytes;
+		/* 동시에 같은 페이지를 읽은 프로세스가 먼저 등록했다면
+		   이 프레임은 그냥 혼자 쓴다. */
+		frame->shared = hash_insert(&shared_frames, &frame->shared_elem) == NULL;
+		lock_release(&frame_lock);
+	}
+	return true;
+}
+
+/* 공유 테이블에서 (INUMBER, OFFSET, READ_BYTES) 페이지를 담은 프레임을
+ * 찾아 PAGE 를 읽기 전용으로 매핑한다. 없으면 false 를 반환한다. */
+static bool
+vm_claim_shared (struct page *page, disk_sector_t inumber, off_t offset,
+		size_t read_bytes) {
+	struct uninit_page *uninit = &page->uninit;
+	void *aux = uninit->aux;
+	struct frame key;
+	struct frame *frame;
+	struct hash_elem *e;
+
+	key.inumber = inumber;
+	key.offset = offset;
+	key.read_bytes = read_bytes;
+	lock_acquire(&frame_lock);
+	e = hash_find(&shared_frames, &key.shared_elem);
+	frame = e != NULL ? hash_entry(e, struct frame, shared_elem) : NULL;
+	// 마지막 공유자가 막 놓은 프레임은 곧 해제되므로 쓰지 않는다.
+	if(frame == NULL || frame->share_cnt == 0){
+		lock_release(&frame_lock);
+		return false;
+	}
+	frame_link_locked(frame, page);
+	lock_release(&frame_lock);
+
+	// 디스크를 읽지 않고 anon 페이지로 바꾼다. aux 는 lazy_load_segment 대신 해제한다.
+	if(!pml4_set_page(thread_current()->pml4, page->va, frame->kva, false)
+			|| !uninit->page_initializer(page, uninit->type, frame->kva)){
+		/* 호출자가 새 프레임에 다시 연결할 수 있도록 연결을 끊는다. */
+		pml4_clear_page(thread_current()->pml4, page->va);
+		vm_frame_unshare(page);
+		return false;
+	}
+	free(aux);
+	return true;
 }
 
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
 	hash_init(&spt->pages,page_hash_func,page_less_func,NULL);
-	lock_init(&spt->page_lock);
+	rwlock_init(&spt->page_lock);
 }
 
 /* Copy supplemental page table from src to dst */
@@ -376,13 +626,16 @@ supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
 	// TODO: src의 각 페이지를 순회하고 dst에 해당 entry의 사본을 만듭니다.
 	// TODO: uninit page를 할당하고 그것을 즉시 claim해야 합니다.
     struct hash_iterator i;
-	lock_acquire(&src->page_lock);
+	// spt 는 struct thread 안에 있으므로 페이지 시작 주소가 곧 부모 스레드이다.
+	struct thread *parent = (struct thread *)pg_round_down(src);
+	rwlock_acquire_read(&src->page_lock);
 	hash_first(&i, &src->pages);
 	while(hash_next(&i)){
 		// src_page 정보
 		struct page *src_page = hash_entry(hash_cur(&i), struct page, elem);
 		struct page *dst_page = NULL;
 		struct file_page *file_aux = NULL;
+		struct frame *frame;
 		enum vm_type type = src_page->operations->type;
 		void *aux = NULL;
 		
@@ -411,24 +664,52 @@ supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
 				break;
 			case VM_ANON:
 				if(!vm_alloc_page(type,src_page->va,src_page->writable)){
-					lock_release(&src->page_lock);
+					rwlock_release_read(&src->page_lock);
 					return false;
 				}
-				
-				if(!vm_claim_page(src_page->va)){
-					lock_release(&src->page_lock);
-					return false;
+				dst_page = spt_find_page(dst,src_page->va);
+
+				/* 내보내는 중인 프레임은 다 쓸 때까지 기다렸다가 스왑 아웃된
+				   페이지로 다룬다. 프레임을 보고 연결하는 사이에 내보내지지
+				   않도록 둘 다 frame_lock 을 잡은 채로 한다. */
+				lock_acquire(&frame_lock);
+				frame_wait_locked(src_page);
+				frame = src_page->frame;
+				if(frame != NULL){
+					frame_link_locked(frame, dst_page);
+				}
+				lock_release(&frame_lock);
+
+				// 스왑 아웃된 페이지는 스왑 슬롯의 내용을 새 프레임으로 읽어온다.
+				if(frame == NULL){
+					if(!vm_claim_page(src_page->va)
+							|| !anon_swap_copy(src_page, dst_page->frame->kva)){
+						rwlock_release_read(&src->page_lock);
+						return false;
+					}
+					break;
 				}
 
-				// 매핑된 프레임에 내용 로딩
-				dst_page = spt_find_page(dst,src_page->va);
-				memcpy(dst_page->frame->kva,src_page->frame->kva,PGSIZE);
+				/* 메모리에 있는 페이지는 복사하지 않고 프레임을 공유한다.
+				   부모와 자식 모두 읽기 전용으로 매핑해 두고
+				   먼저 쓰는 쪽이 vm_handle_wp 에서 복사한다. */
+				anon_initializer(dst_page, type, frame->kva);
+				if(!pml4_set_page(thread_current()->pml4, dst_page->va,
+							frame->kva, false)){
+					rwlock_release_read(&src->page_lock);
+					return false;
+				}
+				if(src_page->writable){
+					pml4_clear_page(parent->pml4, src_page->va);
+					pml4_set_page(parent->pml4, src_page->va,
+							frame->kva, false);
+				}
 				break;
 			case VM_FILE:
 				break;
 		}
 	}
-	lock_release(&src->page_lock);
+	rwlock_release_read(&src->page_lock);
     return true;
 }
 
@@ -450,17 +731,135 @@ supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 	따라서, hash의 요소들만 제거하는 hash_clear를 사용해야 한다.
 	*/
 }
+/* Prints virtual memory statistics. */
+void
+vm_print_stats (void) {
+	printf ("VM (%s): %lld faults, %lld evictions (%lld by kswapd), "
+			"%lld write-backs, %lld refaults\n", replace_policy->name,
+			fault_cnt, evict_cnt, kswapd_cnt, writeback_cnt, refault_cnt);
+}
+
 /*================================================*/
 
 void 
 vm_free_frame(struct frame *frame)
 {
     lock_acquire(&frame_lock);
+    shared_frame_remove(frame);
+    replace_policy->remove(frame);
     list_remove(&frame->elem);
+    frame_cnt--;
+    // 이 프레임을 내보내던 중이었다면 기다리던 스레드들을 깨운다.
+    cond_broadcast(&evict_cond, &frame_lock);
     lock_release(&frame_lock);
     free(frame);
 }
 
+/* PAGE 의 프레임을 다른 스레드가 내보내는 중이면 끝날 때까지 기다린다.
+ * 내보내기가 끝나면 page->frame 은 NULL 이 된다.
+ * frame_lock 을 잡은 상태에서 호출한다. */
+static void
+frame_wait_locked(struct page *page)
+{
+	while(page->frame != NULL && page->frame->pinned){
+		cond_wait(&evict_cond, &frame_lock);
+	}
+}
+
+/* PAGE 의 프레임을 고정해서 반환한다. 고정된 프레임은 내보내지지 않는다.
+ * 다른 스레드가 내보내는 중이면 끝날 때까지 기다리며,
+ * 그래서 프레임이 없어졌으면 NULL 을 반환한다.
+ * 페이지나 프레임을 해제하기 전에 이것으로 내보내기와의 경쟁을 막는다. */
+struct frame *
+vm_frame_pin(struct page *page)
+{
+	struct frame *frame;
+
+	lock_acquire(&frame_lock);
+	frame_wait_locked(page);
+	frame = page->frame;
+	if(frame != NULL){
+		frame->pinned = true;
+	}
+	lock_release(&frame_lock);
+	return frame;
+}
+
+/* vm_frame_pin 으로 고정한 FRAME 을 다시 내보낼 수 있게 한다. */
+void
+vm_frame_unpin(struct frame *frame)
+{
+	lock_acquire(&frame_lock);
+	frame->pinned = false;
+	cond_broadcast(&evict_cond, &frame_lock);
+	lock_release(&frame_lock);
+}
+
+/* PAGE 를 FRAME 에 매핑된 페이지로 등록한다. */
+static void
+vm_frame_link(struct frame *frame, struct page *page)
+{
+	lock_acquire(&frame_lock);
+	frame_link_locked(frame, page);
+	lock_release(&frame_lock);
+}
+
+/* frame_lock 을 잡은 상태에서 호출하는 vm_frame_link. */
+static void
+frame_link_locked(struct frame *frame, struct page *page)
+{
+	if(frame->page == NULL){
+		frame->page = page;
+		frame->owner = page->owner;
+		// 이제 내보낼 수 있는 프레임이 되었다.
+		cond_broadcast(&evict_cond, &frame_lock);
+	}
+	list_push_back(&frame->sharers, &page->share_elem);
+	frame->share_cnt++;
+	page->frame = frame;
+}
+
+/* FRAME 을 공유 테이블에서 뺀다. frame_lock 을 잡은 상태에서 호출한다. */
+static void
+shared_frame_remove(struct frame *frame)
+{
+	if(frame->shared){
+		hash_delete(&shared_frames, &frame->shared_elem);
+		frame->shared = false;
+	}
+}
+
+/* PAGE 가 자신의 프레임에 대한 참조를 놓는다.
+ * 다른 페이지가 아직 프레임을 공유하고 있으면 true 를 반환하며,
+ * 이 경우 호출자는 프레임을 해제해서는 안 된다. */
+bool
+vm_frame_unshare(struct page *page)
+{
+	struct frame *frame = page->frame;
+	bool shared;
+
+	lock_acquire(&frame_lock);
+	list_remove(&page->share_elem);
+	frame->share_cnt--;
+	shared = frame->share_cnt > 0;
+	// 아무도 쓰지 않는 프레임은 다른 프로세스가 공유 테이블에서 찾지 못하게 한다.
+	if(!shared){
+		shared_frame_remove(frame);
+	}
+	// 공유자가 하나만 남으면 내보낼 수 있는 프레임이 된다.
+	if(frame->share_cnt == 1){
+		cond_broadcast(&evict_cond, &frame_lock);
+	}
+	if(frame->page == page){
+		frame->page = shared ? list_entry(list_front(&frame->sharers),
+				struct page, share_elem) : NULL;
+		frame->owner = shared ? frame->page->owner : NULL;
+	}
+	page->frame = NULL;
+	lock_release(&frame_lock);
+	return shared;
+}
+
 static uint64_t
 page_hash_func(const struct hash_elem *e,void *aux UNUSED){
 /* 	struct page *page = hash_entry(e,struct page, elem);
@@ -475,6 +874,25 @@ page_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux U
 	return hash_entry(a,struct page, elem)->va < hash_entry(b,struct page, elem)->va;
 }
 
+static uint64_t
+shared_hash_func(const struct hash_elem *e,void *aux UNUSED){
+	struct frame *f = hash_entry(e,struct frame, shared_elem);
+	return hash_int(f->inumber) ^ hash_int(f->offset) ^ hash_int(f->read_bytes);
+}
+
+static bool
+shared_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED){
+	struct frame *fa = hash_entry(a,struct frame, shared_elem);
+	struct frame *fb = hash_entry(b,struct frame, shared_elem);
+	if(fa->inumber != fb->inumber){
+		return fa->inumber < fb->inumber;
+	}
+	if(fa->offset != fb->offset){
+		return fa->offset < fb->offset;
+	}
+	return fa->read_bytes < fb->read_bytes;
+}
+
 static void 
 hash_destroy_func (struct hash_elem *e, void *aux){
 	vm_dealloc_page(hash_entry(e,struct page,elem));